@@ -0,0 +1,25 @@
+TEMPLATE = app
+
+CONFIG += qt
+
+CONFIG += link_pkgconfig
+PKGCONFIG = glib-2.0 gthread-2.0 connman-qt4
+
+# Only the headers of luna-service2 are used; lunashim.cpp stands in for its library
+QMAKE_CXXFLAGS += $$system(pkg-config --cflags luna-service2)
+
+QT = core dbus
+
+SOURCES = \
+    main.cpp \
+    lunashim.cpp
+
+HEADERS = \
+    lunashim.h
+
+include(../../src/src.pri)
+
+TARGET = adapterbench
+
+OBJECTS_DIR = .obj
+MOC_DIR = .moc
@@ -0,0 +1,228 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <QHash>
+#include <QMultiHash>
+
+#include "lunashim.h"
+
+#define LUNASHIM_UNKNOWN_METHOD_REPLY \
+    "{\"returnValue\":false,\"errorText\":\"Unknown method\"}"
+
+struct LunaShimMethod
+{
+    LSMethodFunction function;
+    void *user_data;
+};
+
+struct LSHandle
+{
+    QHash<QByteArray, LunaShimMethod> methods;
+    QMultiHash<QByteArray, LSMessage*> subscriptions;
+};
+
+struct LSPalmService
+{
+    LSHandle publicHandle;
+    LSHandle privateHandle;
+};
+
+static LSPalmService *registered_service = NULL;
+static unsigned int subscription_posts = 0;
+
+static void add_methods(LSHandle *handle, LSMethod *methods, void *user_data)
+{
+    LunaShimMethod method;
+
+    if (methods == NULL)
+        return;
+
+    for (; methods->name != NULL; methods++) {
+        method.function = methods->function;
+        method.user_data = user_data;
+        handle->methods.insert(methods->name, method);
+    }
+}
+
+static void record_reply(LSMessage *message, const char *payload)
+{
+    if (message->replied == 0)
+        message->replied = g_get_monotonic_time();
+
+    message->replies++;
+    message->reply = payload;
+}
+
+bool LSErrorInit(LSError *error)
+{
+    memset(error, 0, sizeof(*error));
+    return true;
+}
+
+void LSErrorFree(LSError *error)
+{
+    g_free(error->message);
+    error->message = NULL;
+}
+
+void LSErrorPrint(LSError *lserror, FILE *out)
+{
+    fprintf(out, "LUNASERVICE ERROR: %s\n", lserror->message != NULL ? lserror->message : "");
+}
+
+bool LSRegisterPalmService(const char *name, LSPalmService **ret_palm_service, LSError *lserror)
+{
+    Q_UNUSED(name);
+
+    if (registered_service != NULL) {
+        lserror->message = g_strdup("Service is already registered");
+        return false;
+    }
+
+    registered_service = new LSPalmService;
+    *ret_palm_service = registered_service;
+
+    return true;
+}
+
+LSHandle* LSPalmServiceGetPrivateConnection(LSPalmService *psh)
+{
+    return &psh->privateHandle;
+}
+
+bool LSPalmServiceRegisterCategory(LSPalmService *psh, const char *category, LSMethod *methods_public,
+                                   LSMethod *methods_private, LSSignal *langis, void *category_user_data,
+                                   LSError *lserror)
+{
+    Q_UNUSED(category);
+    Q_UNUSED(langis);
+    Q_UNUSED(lserror);
+
+    /* Public methods can be called on both connections, private ones only on the
+     * private one */
+    add_methods(&psh->publicHandle, methods_public, category_user_data);
+    add_methods(&psh->privateHandle, methods_public, category_user_data);
+    add_methods(&psh->privateHandle, methods_private, category_user_data);
+
+    return true;
+}
+
+void LSMessageRef(LSMessage *message)
+{
+    message->ref++;
+}
+
+void LSMessageUnref(LSMessage *message)
+{
+    if (--message->ref == 0)
+        delete message;
+}
+
+const char* LSMessageGetPayload(LSMessage *message)
+{
+    return message->payload.constData();
+}
+
+const char* LSMessageGetMethod(LSMessage *message)
+{
+    return message->method.constData();
+}
+
+bool LSMessageIsSubscription(LSMessage *lsmgs)
+{
+    return lsmgs->subscription;
+}
+
+bool LSMessageReply(LSHandle *sh, LSMessage *lsmsg, const char *replyPayload, LSError *lserror)
+{
+    Q_UNUSED(sh);
+    Q_UNUSED(lserror);
+
+    record_reply(lsmsg, replyPayload);
+
+    return true;
+}
+
+bool LSSubscriptionAdd(LSHandle *sh, const char *key, LSMessage *message, LSError *lserror)
+{
+    Q_UNUSED(lserror);
+
+    LSMessageRef(message);
+    sh->subscriptions.insert(key, message);
+
+    return true;
+}
+
+bool LSSubscriptionReply(LSHandle *sh, const char *key, const char *payload, LSError *lserror)
+{
+    Q_UNUSED(lserror);
+
+    foreach (LSMessage *message, sh->subscriptions.values(key)) {
+        record_reply(message, payload);
+        subscription_posts++;
+    }
+
+    return true;
+}
+
+bool LSSubscriptionSetCancelFunction(LSHandle *sh, LSFilterFunc cancelFunction, void *ctx, LSError *lserror)
+{
+    Q_UNUSED(sh);
+    Q_UNUSED(cancelFunction);
+    Q_UNUSED(ctx);
+    Q_UNUSED(lserror);
+
+    /* Our callers never go away */
+    return true;
+}
+
+LSMessage* lunashim_call(const char *method, const char *payload, bool subscription)
+{
+    LSHandle *handle = &registered_service->privateHandle;
+    LSMessage *message = new LSMessage;
+    LunaShimMethod entry;
+
+    message->ref = 1;
+    message->handle = handle;
+    message->method = method;
+    message->payload = payload;
+    message->subscription = subscription;
+    message->replied = 0;
+    message->replies = 0;
+    message->sent = g_get_monotonic_time();
+
+    if (!handle->methods.contains(method)) {
+        record_reply(message, LUNASHIM_UNKNOWN_METHOD_REPLY);
+        return message;
+    }
+
+    entry = handle->methods.value(method);
+    entry.function(handle, message, entry.user_data);
+
+    return message;
+}
+
+unsigned int lunashim_subscription_posts()
+{
+    return subscription_posts;
+}
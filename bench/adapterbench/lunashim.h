@@ -0,0 +1,55 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#ifndef LUNASHIM_H_
+#define LUNASHIM_H_
+
+#include <glib.h>
+#include <QByteArray>
+#include <luna-service2/lunaservice.h>
+
+/* In-process stand-in for the parts of luna-service2 the adapter uses. Methods the
+ * adapter registers are called directly instead of through the bus and the replies
+ * are kept with the message they answer so the caller can wait for them. Only the
+ * headers of luna-service2 are needed; its library isn't linked. */
+struct LSMessage
+{
+    int ref;
+    LSHandle *handle;
+    QByteArray method;
+    QByteArray payload;
+    bool subscription;
+
+    /* Monotonic time of the call and of the first reply; 0 while there is none */
+    gint64 sent;
+    gint64 replied;
+
+    unsigned int replies;
+    QByteArray reply;
+};
+
+/* Calls the method with the payload on the private connection of the registered
+ * service. The returned message carries a reference for the caller. */
+LSMessage* lunashim_call(const char *method, const char *payload, bool subscription);
+
+/* Number of posts which went to subscribers */
+unsigned int lunashim_subscription_posts();
+
+#endif
@@ -0,0 +1,283 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <QCoreApplication>
+#include <QStringList>
+
+#include "lunashim.h"
+#include "wifiservice.h"
+#include "adaptersettings.h"
+#include "latencyhistogram.h"
+
+/* Longest time we wait for a single reply or for connman to show up, in ms */
+#define BENCH_TIMEOUT       30000
+
+struct BenchCase
+{
+    const char *name;
+    const char *method;
+    /* Calls alternate between both payloads */
+    const char *payloads[2];
+};
+
+static const BenchCase bench_cases[] = {
+    { "getstatus", "getstatus", { "{}", "{}" } },
+    { "findnetworks", "findnetworks", { "{}", "{}" } },
+    { "findnetworks cached", "findnetworks", { "{\"maxAge\":60000}", "{\"maxAge\":60000}" } },
+    { "findnetworks sorted page", "findnetworks",
+      { "{\"maxAge\":60000,\"sortBy\":\"signal\",\"limit\":20}",
+        "{\"maxAge\":60000,\"sortBy\":\"name\",\"limit\":20,\"offset\":20}" } },
+    { "connect", "connect", { "{\"ssid\":\"bench-0000\"}", "{\"ssid\":\"bench-0001\"}" } },
+    { "getprofilelist", "getprofilelist", { "{}", "{}" } },
+};
+
+#define BENCH_CASE_COUNT    (sizeof(bench_cases) / sizeof(bench_cases[0]))
+
+struct BenchOptions
+{
+    BenchOptions() :
+        networks(10),
+        iterations(200),
+        subscribers(0),
+        verbose(false)
+    {
+    }
+
+    int networks;
+    unsigned int iterations;
+    unsigned int subscribers;
+    bool verbose;
+};
+
+static void usage()
+{
+    fprintf(stderr, "Usage: adapterbench [--networks N] [--iterations N] [--subscribers N] [--verbose]\n"
+                    "Runs against the connman on the bus DBUS_SYSTEM_BUS_ADDRESS points to; N networks\n"
+                    "have to be in range. At most %d iterations are measured.\n",
+            LATENCY_HISTOGRAM_SAMPLES);
+}
+
+static bool parse_options(const QStringList& arguments, BenchOptions& options)
+{
+    bool ok = true;
+    int n;
+
+    for (n = 1; n < arguments.size() && ok; n++) {
+        if (arguments[n] == "--verbose") {
+            options.verbose = true;
+            continue;
+        }
+
+        if (n + 1 >= arguments.size())
+            return false;
+
+        if (arguments[n] == "--networks")
+            options.networks = arguments[++n].toInt(&ok);
+        else if (arguments[n] == "--iterations")
+            options.iterations = arguments[++n].toUInt(&ok);
+        else if (arguments[n] == "--subscribers")
+            options.subscribers = arguments[++n].toUInt(&ok);
+        else
+            return false;
+    }
+
+    return ok && options.networks >= 0 && options.iterations > 0 &&
+           options.iterations <= LATENCY_HISTOGRAM_SAMPLES;
+}
+
+/* The adapter is chatty; its debug output would only drown the results */
+static void quiet_message_handler(QtMsgType type, const char *message)
+{
+    if (type != QtDebugMsg)
+        fprintf(stderr, "%s\n", message);
+
+    if (type == QtFatalMsg)
+        abort();
+}
+
+static gboolean cb_timeout(gpointer user_data)
+{
+    *((bool*) user_data) = true;
+    return FALSE;
+}
+
+/* Runs the main loop until the message got its first reply */
+static bool wait_for_reply(LSMessage *message, unsigned int timeout)
+{
+    bool timedOut = false;
+    guint source;
+
+    if (message->replied != 0)
+        return true;
+
+    source = g_timeout_add(timeout, cb_timeout, &timedOut);
+
+    while (message->replied == 0 && !timedOut)
+        g_main_context_iteration(NULL, TRUE);
+
+    if (!timedOut)
+        g_source_remove(source);
+
+    return message->replied != 0;
+}
+
+static void run_main_loop(unsigned int timeout)
+{
+    bool timedOut = false;
+
+    g_timeout_add(timeout, cb_timeout, &timedOut);
+
+    while (!timedOut)
+        g_main_context_iteration(NULL, TRUE);
+}
+
+/* Waits until wifi is up and a scan reports all networks */
+static bool wait_for_networks(int networks)
+{
+    gint64 deadline = g_get_monotonic_time() + (gint64) BENCH_TIMEOUT * 1000;
+    LSMessage *message;
+    int found;
+
+    while (g_get_monotonic_time() < deadline) {
+        message = lunashim_call("findnetworks", "{}", false);
+
+        found = -1;
+        if (wait_for_reply(message, BENCH_TIMEOUT))
+            found = message->reply.count("\"networkInfo\"");
+
+        LSMessageUnref(message);
+
+        if (found == networks)
+            return true;
+
+        /* Requests are refused until connman reported the wifi technology */
+        run_main_loop(100);
+    }
+
+    return false;
+}
+
+static void run_case(const BenchCase& benchCase, unsigned int iterations)
+{
+    LatencyHistogram latencies;
+    unsigned int failed = 0;
+    LSMessage *message;
+    gint64 began, elapsed;
+    unsigned int n;
+
+    began = g_get_monotonic_time();
+
+    for (n = 0; n < iterations; n++) {
+        message = lunashim_call(benchCase.method, benchCase.payloads[n % 2], false);
+
+        if (wait_for_reply(message, BENCH_TIMEOUT) && message->reply.contains("\"returnValue\":true"))
+            latencies.add(message->replied - message->sent);
+        else
+            failed++;
+
+        LSMessageUnref(message);
+    }
+
+    elapsed = g_get_monotonic_time() - began;
+
+    printf("%-26s %7u %7u %10u %10u %10.1f\n", benchCase.name, iterations, failed,
+           latencies.percentile(50), latencies.percentile(99),
+           elapsed > 0 ? iterations * 1000000.0 / elapsed : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    AdapterSettings *settings = AdapterSettings::instance();
+    WifiNetworkService *service = NULL;
+    QList<LSMessage*> subscriptions;
+    LSPalmService *palmService;
+    BenchOptions options;
+    LSError lserror;
+    gchar *directory;
+    unsigned int n;
+    int ret = 1;
+
+    LSErrorInit(&lserror);
+
+    if (!parse_options(app.arguments(), options)) {
+        usage();
+        return 1;
+    }
+
+    if (!options.verbose)
+        qInstallMsgHandler(quiet_message_handler);
+
+    /* Profiles and status of the benchmark mustn't end up where the real ones are */
+    directory = g_dir_make_tmp("adapterbench-XXXXXX", NULL);
+    if (directory == NULL) {
+        fprintf(stderr, "Failed to create a temporary directory\n");
+        return 1;
+    }
+
+    settings->profileStorePath = QString(directory) + "/profiles";
+    settings->statusFilePath = QString(directory) + "/status";
+    settings->onDemand = false;
+
+    if (!LSRegisterPalmService("com.palm.wifi", &palmService, &lserror)) {
+        LSErrorPrint(&lserror, stderr);
+        LSErrorFree(&lserror);
+        goto done;
+    }
+
+    service = new WifiNetworkService();
+    service->start(palmService);
+
+    if (!wait_for_networks(options.networks)) {
+        fprintf(stderr, "connman didn't report %d networks within %d ms\n", options.networks, BENCH_TIMEOUT);
+        goto done;
+    }
+
+    for (n = 0; n < options.subscribers; n++)
+        subscriptions.append(lunashim_call("getstatus", "{\"subscribe\":true}", true));
+
+    printf("networks %d, subscribers %u\n", options.networks, options.subscribers);
+    printf("%-26s %7s %7s %10s %10s %10s\n", "method", "calls", "failed", "p50 us", "p99 us", "calls/s");
+
+    for (n = 0; n < BENCH_CASE_COUNT; n++)
+        run_case(bench_cases[n], options.iterations);
+
+    printf("subscription posts %u\n", lunashim_subscription_posts());
+
+    ret = 0;
+
+done:
+    foreach (LSMessage *message, subscriptions)
+        LSMessageUnref(message);
+
+    delete service;
+
+    g_unlink(settings->profileStorePath.toUtf8().constData());
+    g_unlink(settings->statusFilePath.toUtf8().constData());
+    g_rmdir(directory);
+    g_free(directory);
+
+    return ret;
+}
@@ -0,0 +1,496 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#include "fakeconnman.h"
+
+/* States a connect goes through; connman answers the Connect call once the
+ * service is ready */
+static const char *connect_states[] = {
+    "association",
+    "configuration",
+    "ready",
+    "online"
+};
+
+#define CONNECT_STATE_COUNT     ((int) (sizeof(connect_states) / sizeof(connect_states[0])))
+#define CONNECT_STATE_READY     2
+
+QDBusArgument& operator<<(QDBusArgument& argument, const ConnmanObject& object)
+{
+    argument.beginStructure();
+    argument << object.path << object.properties;
+    argument.endStructure();
+    return argument;
+}
+
+const QDBusArgument& operator>>(const QDBusArgument& argument, ConnmanObject& object)
+{
+    argument.beginStructure();
+    argument >> object.path >> object.properties;
+    argument.endStructure();
+    return argument;
+}
+
+void register_connman_types()
+{
+    qDBusRegisterMetaType<ConnmanObject>();
+    qDBusRegisterMetaType<ConnmanObjectList>();
+    qDBusRegisterMetaType<QList<QDBusObjectPath> >();
+}
+
+static void send_property_changed(const QString& path, const char *interface,
+                                  const QString& name, const QVariant& value)
+{
+    QDBusMessage signal = QDBusMessage::createSignal(path, interface, "PropertyChanged");
+
+    signal << name << QVariant::fromValue(QDBusVariant(value));
+
+    QDBusConnection::systemBus().send(signal);
+}
+
+static QVariantMap ipv4_properties(bool configured)
+{
+    QVariantMap ipv4;
+
+    if (configured) {
+        ipv4.insert("Method", "dhcp");
+        ipv4.insert("Address", "192.168.1.100");
+        ipv4.insert("Netmask", "255.255.255.0");
+        ipv4.insert("Gateway", "192.168.1.1");
+    }
+
+    return ipv4;
+}
+
+FakeService::FakeService(FakeManager *manager, int index) :
+    QObject(manager),
+    _manager(manager)
+{
+    QString name = QString("bench-%1").arg(index, 4, 10, QChar('0'));
+    QString security = index % 4 == 3 ? "psk" : "none";
+    QVariantMap ethernet;
+
+    _path = QString("/net/connman/service/wifi_001122334455_%1_managed_%2")
+                .arg(QString(name.toUtf8().toHex())).arg(security);
+
+    ethernet.insert("Method", "auto");
+    ethernet.insert("Interface", "wlan0");
+    ethernet.insert("Address", "00:11:22:33:44:55");
+
+    _properties.insert("Name", name);
+    _properties.insert("Type", "wifi");
+    _properties.insert("Security", QStringList(security));
+    _properties.insert("Strength", QVariant::fromValue((uchar) (20 + (index * 37) % 80)));
+    _properties.insert("State", "idle");
+    /* Some of the networks are known to connman already */
+    _properties.insert("Favorite", index % 10 == 0);
+    _properties.insert("AutoConnect", false);
+    _properties.insert("IPv4", ipv4_properties(false));
+    _properties.insert("Nameservers", QStringList());
+    _properties.insert("Domains", QStringList());
+    _properties.insert("Ethernet", ethernet);
+}
+
+FakeService::~FakeService()
+{
+}
+
+void FakeService::changeProperty(const QString& name, const QVariant& value)
+{
+    _properties.insert(name, value);
+    send_property_changed(_path, CONNMAN_SERVICE_INTERFACE, name, value);
+}
+
+QVariantMap FakeService::GetProperties()
+{
+    return _properties;
+}
+
+void FakeService::SetProperty(const QString& name, const QDBusVariant& value)
+{
+    changeProperty(name, value.variant());
+}
+
+void FakeService::Connect()
+{
+    setDelayedReply(true);
+    _manager->connectService(this, message());
+}
+
+void FakeService::Disconnect()
+{
+    _manager->disconnectService(this);
+}
+
+void FakeService::Remove()
+{
+    _manager->disconnectService(this);
+    changeProperty("Favorite", false);
+}
+
+FakeTechnology::FakeTechnology(FakeManager *manager) :
+    QObject(manager),
+    _manager(manager)
+{
+    _properties.insert("Name", "WiFi");
+    _properties.insert("Type", "wifi");
+    _properties.insert("Powered", true);
+    _properties.insert("Connected", false);
+    _properties.insert("Tethering", false);
+}
+
+FakeTechnology::~FakeTechnology()
+{
+}
+
+bool FakeTechnology::isPowered() const
+{
+    return _properties.value("Powered").toBool();
+}
+
+void FakeTechnology::changeProperty(const QString& name, const QVariant& value)
+{
+    _properties.insert(name, value);
+    send_property_changed(FAKE_TECHNOLOGY_PATH, CONNMAN_TECHNOLOGY_INTERFACE, name, value);
+}
+
+QVariantMap FakeTechnology::GetProperties()
+{
+    return _properties;
+}
+
+void FakeTechnology::SetProperty(const QString& name, const QDBusVariant& value)
+{
+    bool powered = isPowered();
+
+    changeProperty(name, value.variant());
+
+    if (name == "Powered" && isPowered() != powered)
+        _manager->powerChanged(isPowered());
+}
+
+void FakeTechnology::Scan()
+{
+    if (!isPowered()) {
+        sendErrorReply("net.connman.Error.NotReady", "Not ready");
+        return;
+    }
+
+    setDelayedReply(true);
+    _manager->scan(message());
+}
+
+FakeManager::FakeManager(const FakeConnmanOptions& options, QObject *parent) :
+    QObject(parent),
+    _options(options),
+    _technology(new FakeTechnology(this)),
+    _connecting(NULL),
+    _connected(NULL),
+    _connectStep(0),
+    _nextStrengthChange(0)
+{
+    int n;
+
+    _properties.insert("State", "idle");
+    _properties.insert("OfflineMode", false);
+    _properties.insert("SessionMode", false);
+
+    for (n = 0; n < _options.networks; n++)
+        _services.append(new FakeService(this, n));
+
+    _connectTimer.setSingleShot(true);
+    connect(&_connectTimer, SIGNAL(timeout()), this, SLOT(advanceConnect()));
+
+    _scanTimer.setSingleShot(true);
+    connect(&_scanTimer, SIGNAL(timeout()), this, SLOT(finishScan()));
+
+    connect(&_strengthTimer, SIGNAL(timeout()), this, SLOT(changeStrength()));
+    if (_options.strengthInterval > 0 && !_services.isEmpty())
+        _strengthTimer.start(_options.strengthInterval);
+}
+
+FakeManager::~FakeManager()
+{
+}
+
+bool FakeManager::registerOnBus()
+{
+    QDBusConnection bus = QDBusConnection::systemBus();
+
+    if (!bus.registerObject("/", this, QDBusConnection::ExportAllSlots))
+        return false;
+
+    if (!bus.registerObject(FAKE_TECHNOLOGY_PATH, _technology, QDBusConnection::ExportAllSlots))
+        return false;
+
+    foreach (FakeService *service, _services) {
+        if (!bus.registerObject(service->path(), service, QDBusConnection::ExportAllSlots))
+            return false;
+    }
+
+    /* Taking the name last lets connman-qt find everything in place once it notices
+     * connman appeared */
+    return bus.registerService(CONNMAN_SERVICE);
+}
+
+void FakeManager::changeProperty(const QString& name, const QVariant& value)
+{
+    _properties.insert(name, value);
+    send_property_changed("/", CONNMAN_MANAGER_INTERFACE, name, value);
+}
+
+QVariantMap FakeManager::GetProperties()
+{
+    return _properties;
+}
+
+void FakeManager::SetProperty(const QString& name, const QDBusVariant& value)
+{
+    changeProperty(name, value.variant());
+}
+
+ConnmanObjectList FakeManager::GetTechnologies()
+{
+    ConnmanObjectList technologies;
+    ConnmanObject technology;
+
+    technology.path = QDBusObjectPath(FAKE_TECHNOLOGY_PATH);
+    technology.properties = _technology->properties();
+    technologies.append(technology);
+
+    return technologies;
+}
+
+ConnmanObjectList FakeManager::GetServices()
+{
+    ConnmanObjectList services;
+    ConnmanObject object;
+
+    if (!_technology->isPowered())
+        return services;
+
+    foreach (FakeService *service, _services) {
+        object.path = QDBusObjectPath(service->path());
+        object.properties = service->properties();
+        services.append(object);
+    }
+
+    return services;
+}
+
+void FakeManager::RegisterAgent(const QDBusObjectPath& path)
+{
+    Q_UNUSED(path);
+}
+
+void FakeManager::UnregisterAgent(const QDBusObjectPath& path)
+{
+    Q_UNUSED(path);
+}
+
+void FakeManager::connectService(FakeService *service, const QDBusMessage& message)
+{
+    QDBusConnection bus = QDBusConnection::systemBus();
+
+    if (!_technology->isPowered()) {
+        bus.send(message.createErrorReply("net.connman.Error.NotReady", "Not ready"));
+        return;
+    }
+
+    if (service == _connecting || service == _connected) {
+        bus.send(message.createErrorReply("net.connman.Error.AlreadyConnected", "Already connected"));
+        return;
+    }
+
+    /* Only one service is connected at a time; whatever we were connecting or
+     * connected to goes down first */
+    abortConnect();
+
+    if (_connecting != NULL)
+        setServiceIdle(_connecting);
+
+    if (_connected != NULL && _connected != _connecting)
+        setServiceIdle(_connected);
+
+    _connecting = service;
+    _connected = NULL;
+    _pendingConnect = message;
+    _connectStep = 0;
+
+    service->changeProperty("State", connect_states[_connectStep]);
+    changeProperty("State", "idle");
+
+    _connectTimer.start(_options.connectStep);
+}
+
+void FakeManager::disconnectService(FakeService *service)
+{
+    if (service != _connecting && service != _connected)
+        return;
+
+    abortConnect();
+    _connectTimer.stop();
+
+    setServiceIdle(service);
+
+    _connecting = NULL;
+    _connected = NULL;
+
+    changeProperty("State", "idle");
+}
+
+void FakeManager::abortConnect()
+{
+    if (_pendingConnect.type() != QDBusMessage::MethodCallMessage)
+        return;
+
+    QDBusConnection::systemBus().send(
+        _pendingConnect.createErrorReply("net.connman.Error.OperationAborted", "Operation aborted"));
+    _pendingConnect = QDBusMessage();
+}
+
+void FakeManager::setServiceIdle(FakeService *service)
+{
+    service->changeProperty("State", "idle");
+    service->changeProperty("IPv4", ipv4_properties(false));
+}
+
+void FakeManager::advanceConnect()
+{
+    if (_connecting == NULL)
+        return;
+
+    _connectStep++;
+
+    if (_connectStep == CONNECT_STATE_READY) {
+        _connecting->changeProperty("IPv4", ipv4_properties(true));
+        _connecting->changeProperty("Favorite", true);
+    }
+
+    _connecting->changeProperty("State", connect_states[_connectStep]);
+
+    if (_connectStep == CONNECT_STATE_READY) {
+        QDBusConnection::systemBus().send(_pendingConnect.createReply());
+        _pendingConnect = QDBusMessage();
+
+        _connected = _connecting;
+        changeProperty("State", "ready");
+    }
+
+    if (_connectStep == CONNECT_STATE_COUNT - 1) {
+        _connecting = NULL;
+        changeProperty("State", "online");
+        return;
+    }
+
+    _connectTimer.start(_options.connectStep);
+}
+
+void FakeManager::powerChanged(bool powered)
+{
+    QList<QDBusObjectPath> removed;
+
+    /* The networks come and go with the radio */
+    if (powered) {
+        sendServicesChanged(GetServices(), removed);
+        return;
+    }
+
+    if (_connecting != NULL)
+        disconnectService(_connecting);
+    else if (_connected != NULL)
+        disconnectService(_connected);
+
+    _scanTimer.stop();
+    foreach (const QDBusMessage& message, _pendingScans)
+        QDBusConnection::systemBus().send(message.createErrorReply("net.connman.Error.Aborted", "Aborted"));
+    _pendingScans.clear();
+
+    foreach (FakeService *service, _services)
+        removed.append(QDBusObjectPath(service->path()));
+
+    sendServicesChanged(ConnmanObjectList(), removed);
+}
+
+void FakeManager::scan(const QDBusMessage& message)
+{
+    _pendingScans.append(message);
+
+    /* Callers arriving while a scan is running get the results of that one */
+    if (!_scanTimer.isActive())
+        _scanTimer.start(_options.scanDuration);
+}
+
+void FakeManager::finishScan()
+{
+    ConnmanObjectList changed;
+    ConnmanObject object;
+    int n;
+
+    /* Every scan sees about a quarter of the networks with a slightly different
+     * signal; connman reports them with all their properties */
+    for (n = 0; n < _services.size(); n++) {
+        if (qrand() % 4 != 0)
+            continue;
+
+        changeServiceStrength(_services[n], qrand() % 7 - 3);
+
+        object.path = QDBusObjectPath(_services[n]->path());
+        object.properties = _services[n]->properties();
+        changed.append(object);
+    }
+
+    sendServicesChanged(changed, QList<QDBusObjectPath>());
+
+    foreach (const QDBusMessage& message, _pendingScans)
+        QDBusConnection::systemBus().send(message.createReply());
+    _pendingScans.clear();
+}
+
+void FakeManager::changeStrength()
+{
+    FakeService *service = _services[_nextStrengthChange];
+
+    _nextStrengthChange = (_nextStrengthChange + 1) % _services.size();
+
+    changeServiceStrength(service, qrand() % 11 - 5);
+
+    if (_connected != NULL && _connected != service)
+        changeServiceStrength(_connected, qrand() % 11 - 5);
+}
+
+void FakeManager::changeServiceStrength(FakeService *service, int delta)
+{
+    int strength = service->properties().value("Strength").toInt() + delta;
+
+    strength = qBound(5, strength, 100);
+
+    service->changeProperty("Strength", QVariant::fromValue((uchar) strength));
+}
+
+void FakeManager::sendServicesChanged(const ConnmanObjectList& changed,
+                                      const QList<QDBusObjectPath>& removed)
+{
+    QDBusMessage signal = QDBusMessage::createSignal("/", CONNMAN_MANAGER_INTERFACE, "ServicesChanged");
+
+    signal << QVariant::fromValue(changed) << QVariant::fromValue(removed);
+
+    QDBusConnection::systemBus().send(signal);
+}
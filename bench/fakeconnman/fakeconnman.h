@@ -0,0 +1,190 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#ifndef FAKECONNMAN_H_
+#define FAKECONNMAN_H_
+
+#include <QtDBus>
+#include <QTimer>
+
+#define CONNMAN_SERVICE                 "net.connman"
+#define CONNMAN_MANAGER_INTERFACE       "net.connman.Manager"
+#define CONNMAN_TECHNOLOGY_INTERFACE    "net.connman.Technology"
+#define CONNMAN_SERVICE_INTERFACE       "net.connman.Service"
+
+#define FAKE_TECHNOLOGY_PATH            "/net/connman/technology/wifi"
+
+/* Element of the a(oa{sv}) lists connman reports technologies and services with */
+struct ConnmanObject
+{
+    QDBusObjectPath path;
+    QVariantMap properties;
+};
+
+typedef QList<ConnmanObject> ConnmanObjectList;
+
+Q_DECLARE_METATYPE(ConnmanObject)
+Q_DECLARE_METATYPE(ConnmanObjectList)
+
+QDBusArgument& operator<<(QDBusArgument& argument, const ConnmanObject& object);
+const QDBusArgument& operator>>(const QDBusArgument& argument, ConnmanObject& object);
+
+void register_connman_types();
+
+/* What the fake connman simulates; all times are in milliseconds */
+struct FakeConnmanOptions
+{
+    FakeConnmanOptions() :
+        networks(10),
+        scanDuration(100),
+        connectStep(50),
+        strengthInterval(0)
+    {
+    }
+
+    /* Number of wifi networks in range */
+    int networks;
+    /* Time a scan takes until its results are reported */
+    unsigned int scanDuration;
+    /* Time a connect spends in each of association, configuration and ready */
+    unsigned int connectStep;
+    /* Interval in which the strength of a network and the connected one changes;
+     * 0 keeps strengths stable between scans */
+    unsigned int strengthInterval;
+};
+
+class FakeManager;
+
+/* A wifi network in range */
+class FakeService : public QObject, protected QDBusContext
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "net.connman.Service")
+
+public:
+    FakeService(FakeManager *manager, int index);
+    ~FakeService();
+
+    const QString& path() const { return _path; }
+    const QVariantMap& properties() const { return _properties; }
+
+    /* Changes the property and tells our clients about it */
+    void changeProperty(const QString& name, const QVariant& value);
+
+public slots:
+    QVariantMap GetProperties();
+    void SetProperty(const QString& name, const QDBusVariant& value);
+    void Connect();
+    void Disconnect();
+    void Remove();
+
+private:
+    FakeManager *_manager;
+    QString _path;
+    QVariantMap _properties;
+};
+
+/* The wifi technology; it's the only one we have */
+class FakeTechnology : public QObject, protected QDBusContext
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "net.connman.Technology")
+
+public:
+    FakeTechnology(FakeManager *manager);
+    ~FakeTechnology();
+
+    const QVariantMap& properties() const { return _properties; }
+    bool isPowered() const;
+
+    void changeProperty(const QString& name, const QVariant& value);
+
+public slots:
+    QVariantMap GetProperties();
+    void SetProperty(const QString& name, const QDBusVariant& value);
+    void Scan();
+
+private:
+    FakeManager *_manager;
+    QVariantMap _properties;
+};
+
+/* Stands in for connman on the bus. It offers the net.connman.Manager,
+ * net.connman.Technology and net.connman.Service interfaces as far as connman-qt
+ * uses them and scripts a configurable number of open and protected networks,
+ * scans which take a while, connects going through all states and strength changes.
+ * Objects are published on the bus DBUS_SYSTEM_BUS_ADDRESS points to, which is
+ * where connman-qt looks for connman. */
+class FakeManager : public QObject, protected QDBusContext
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "net.connman.Manager")
+
+public:
+    FakeManager(const FakeConnmanOptions& options, QObject *parent = 0);
+    ~FakeManager();
+
+    bool registerOnBus();
+
+    /* Takes over answering the Connect call in message */
+    void connectService(FakeService *service, const QDBusMessage& message);
+    void disconnectService(FakeService *service);
+
+    /* Takes over answering the Scan call in message */
+    void scan(const QDBusMessage& message);
+
+    void powerChanged(bool powered);
+
+public slots:
+    QVariantMap GetProperties();
+    void SetProperty(const QString& name, const QDBusVariant& value);
+    ConnmanObjectList GetTechnologies();
+    ConnmanObjectList GetServices();
+    void RegisterAgent(const QDBusObjectPath& path);
+    void UnregisterAgent(const QDBusObjectPath& path);
+
+private slots:
+    void advanceConnect();
+    void finishScan();
+    void changeStrength();
+
+private:
+    FakeConnmanOptions _options;
+    QVariantMap _properties;
+    FakeTechnology *_technology;
+    QList<FakeService*> _services;
+    FakeService *_connecting;
+    FakeService *_connected;
+    QDBusMessage _pendingConnect;
+    int _connectStep;
+    QTimer _connectTimer;
+    QList<QDBusMessage> _pendingScans;
+    QTimer _scanTimer;
+    QTimer _strengthTimer;
+    int _nextStrengthChange;
+
+    void changeProperty(const QString& name, const QVariant& value);
+    void setServiceIdle(FakeService *service);
+    void abortConnect();
+    void changeServiceStrength(FakeService *service, int delta);
+    void sendServicesChanged(const ConnmanObjectList& changed, const QList<QDBusObjectPath>& removed);
+};
+
+#endif
@@ -0,0 +1,17 @@
+TEMPLATE = app
+
+CONFIG += qt
+
+QT = core dbus
+
+SOURCES = \
+    main.cpp \
+    fakeconnman.cpp
+
+HEADERS = \
+    fakeconnman.h
+
+TARGET = fakeconnman
+
+OBJECTS_DIR = .obj
+MOC_DIR = .moc
@@ -0,0 +1,84 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#include <stdio.h>
+
+#include <QCoreApplication>
+#include <QStringList>
+
+#include "fakeconnman.h"
+
+static void usage()
+{
+    fprintf(stderr, "Usage: fakeconnman [--networks N] [--scan-duration MS] [--connect-step MS]\n"
+                    "                   [--strength-interval MS]\n");
+}
+
+static bool parse_options(const QStringList& arguments, FakeConnmanOptions& options)
+{
+    bool ok = true;
+    int n;
+
+    for (n = 1; n < arguments.size() && ok; n += 2) {
+        if (n + 1 >= arguments.size())
+            return false;
+
+        if (arguments[n] == "--networks")
+            options.networks = arguments[n + 1].toInt(&ok);
+        else if (arguments[n] == "--scan-duration")
+            options.scanDuration = arguments[n + 1].toUInt(&ok);
+        else if (arguments[n] == "--connect-step")
+            options.connectStep = arguments[n + 1].toUInt(&ok);
+        else if (arguments[n] == "--strength-interval")
+            options.strengthInterval = arguments[n + 1].toUInt(&ok);
+        else
+            return false;
+    }
+
+    return ok && options.networks >= 0;
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    FakeConnmanOptions options;
+
+    if (!parse_options(app.arguments(), options)) {
+        usage();
+        return 1;
+    }
+
+    if (!QDBusConnection::systemBus().isConnected()) {
+        fprintf(stderr, "Failed to connect to the bus; is DBUS_SYSTEM_BUS_ADDRESS set?\n");
+        return 1;
+    }
+
+    register_connman_types();
+
+    FakeManager manager(options);
+
+    if (!manager.registerOnBus()) {
+        fprintf(stderr, "Failed to register on the bus: %s\n",
+                QDBusConnection::systemBus().lastError().message().toUtf8().constData());
+        return 1;
+    }
+
+    return app.exec();
+}
@@ -0,0 +1,58 @@
+#!/bin/sh
+#
+# Runs adapterbench against fakeconnman on a private bus for 10, 100 and 1000
+# networks in range. Build both with qmake && make in this directory first.
+#
+# NETWORKS, ITERATIONS and SUBSCRIBERS override what's measured; FAKECONNMAN_ARGS
+# is passed on to fakeconnman (e.g. "--strength-interval 50").
+
+set -e
+
+BENCH_DIR=$(cd "$(dirname "$0")" && pwd)
+FAKECONNMAN="$BENCH_DIR/fakeconnman/fakeconnman"
+ADAPTERBENCH="$BENCH_DIR/adapterbench/adapterbench"
+
+NETWORKS=${NETWORKS:-"10 100 1000"}
+ITERATIONS=${ITERATIONS:-200}
+SUBSCRIBERS=${SUBSCRIBERS:-0}
+FAKECONNMAN_ARGS=${FAKECONNMAN_ARGS:-"--scan-duration 20 --connect-step 10"}
+
+bus=$(dbus-daemon --session --fork --print-address=1 --print-pid=1)
+DBUS_SYSTEM_BUS_ADDRESS=$(echo "$bus" | sed -n 1p)
+bus_pid=$(echo "$bus" | sed -n 2p)
+export DBUS_SYSTEM_BUS_ADDRESS
+
+fake_pid=
+cleanup() {
+    [ -n "$fake_pid" ] && kill "$fake_pid" 2>/dev/null
+    kill "$bus_pid" 2>/dev/null
+}
+trap cleanup EXIT
+
+wait_for_connman() {
+    for i in $(seq 100); do
+        if dbus-send --bus="$DBUS_SYSTEM_BUS_ADDRESS" --print-reply --dest=org.freedesktop.DBus \
+               /org/freedesktop/DBus org.freedesktop.DBus.NameHasOwner string:net.connman 2>/dev/null |
+               grep -q "boolean true"; then
+            return 0
+        fi
+        sleep 0.1
+    done
+
+    echo "fakeconnman didn't show up on the bus" >&2
+    return 1
+}
+
+for networks in $NETWORKS; do
+    $FAKECONNMAN --networks "$networks" $FAKECONNMAN_ARGS &
+    fake_pid=$!
+
+    wait_for_connman
+
+    $ADAPTERBENCH --networks "$networks" --iterations "$ITERATIONS" --subscribers "$SUBSCRIBERS"
+    echo
+
+    kill "$fake_pid"
+    wait "$fake_pid" 2>/dev/null || true
+    fake_pid=
+done
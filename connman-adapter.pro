@@ -5,23 +5,18 @@ CONFIG += qt
 TARGET_TYPE =
 
 CONFIG += link_pkgconfig
-PKGCONFIG = glib-2.0 gthread-2.0 luna-service2 cjson connman-qt4
+PKGCONFIG = glib-2.0 gthread-2.0 luna-service2 connman-qt4
 
 QT = core dbus
 
 SOURCES = \
     src/main.cpp \
-    src/servicemgr.cpp \
-    src/wifiservice.cpp \
-    src/connmanagent.cpp \
-    src/utilities.cpp
+    src/servicemgr.cpp
 
 HEADERS = \
-    src/servicemgr.h \
-    src/wifiservice.h \
-    src/connmanagent.h \
-    src/serviceprofile.h \
-    src/utilities.h
+    src/servicemgr.h
+
+include(src/src.pri)
 
 TARGET = connman-adapter
 
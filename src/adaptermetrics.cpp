@@ -0,0 +1,191 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#include <string.h>
+
+#include "adaptermetrics.h"
+
+static const char *signal_names[AdapterMetrics::SIGNAL_COUNT] = {
+    "availabilityChanged",
+    "technologiesChanged",
+    "servicesChanged",
+    "poweredChanged",
+    "connectedChanged",
+    "scanFinished",
+    "stateChanged",
+    "strengthChanged",
+    "ipv4Changed",
+    "nameChanged",
+    "serviceChanged"
+};
+
+AdapterMetrics::AdapterMetrics() :
+    _methodCount(0),
+    _currentCall(NULL),
+    _callStarted(0),
+    _posts(0),
+    _postedBytes(0),
+    _scans(0),
+    _scanStarted(0),
+    _startupDuration(0)
+{
+    std::fill(_signals, _signals + SIGNAL_COUNT, 0);
+}
+
+AdapterMetrics::~AdapterMetrics()
+{
+}
+
+AdapterMetrics::MethodMetrics* AdapterMetrics::method(const char *name)
+{
+    int n;
+
+    /* There are only a handful of methods so searching them is cheap enough */
+    for (n = 0; n < _methodCount; n++) {
+        if (!strcmp(_methods[n].name, name))
+            return &_methods[n];
+    }
+
+    if (_methodCount == METRICS_MAX_METHODS)
+        return NULL;
+
+    _methods[_methodCount].name = name;
+    _methods[_methodCount].calls = 0;
+    _methods[_methodCount].errors = 0;
+
+    return &_methods[_methodCount++];
+}
+
+void AdapterMetrics::beginCall(const char *name)
+{
+    _currentCall = method(name);
+    _callStarted = g_get_monotonic_time();
+}
+
+void AdapterMetrics::endCall()
+{
+    if (_currentCall == NULL)
+        return;
+
+    _currentCall->calls++;
+    _currentCall->latency.add(g_get_monotonic_time() - _callStarted);
+    _currentCall = NULL;
+}
+
+void AdapterMetrics::countError(const char *name)
+{
+    MethodMetrics *metrics = method(name);
+
+    if (metrics != NULL)
+        metrics->errors++;
+}
+
+void AdapterMetrics::countSignal(ConnmanSignal signal)
+{
+    _signals[signal]++;
+}
+
+void AdapterMetrics::countPost(unsigned int payloadLength)
+{
+    _posts++;
+    _postedBytes += payloadLength;
+}
+
+void AdapterMetrics::scanStarted()
+{
+    _scans++;
+    _scanStarted = g_get_monotonic_time();
+}
+
+void AdapterMetrics::scanFinished()
+{
+    if (_scanStarted == 0)
+        return;
+
+    _scanDuration.add((g_get_monotonic_time() - _scanStarted) / 1000);
+    _scanStarted = 0;
+}
+
+void AdapterMetrics::setStartupDuration(unsigned int duration)
+{
+    _startupDuration = duration;
+}
+
+void AdapterMetrics::appendHistogramToMessage(JsonWriter& message, const LatencyHistogram& histogram)
+{
+    int n;
+
+    message.beginObject();
+    message.member("samples", histogram.count());
+    message.member("p50", histogram.percentile(50));
+    message.member("p90", histogram.percentile(90));
+    message.member("p99", histogram.percentile(99));
+
+    /* Only buckets with samples; the one without upper bound has no "le" */
+    message.key("buckets").beginArray();
+    for (n = 0; n < LATENCY_HISTOGRAM_BUCKETS; n++) {
+        if (histogram.bucket(n) == 0)
+            continue;
+
+        message.beginObject();
+        if (n < LATENCY_HISTOGRAM_BUCKETS - 1)
+            message.member("le", LatencyHistogram::bucketBound(n));
+        message.member("count", histogram.bucket(n));
+        message.endObject();
+    }
+    message.endArray();
+
+    message.endObject();
+}
+
+void AdapterMetrics::appendToMessage(JsonWriter& message) const
+{
+    int n;
+
+    message.member("startupMs", _startupDuration);
+
+    message.key("methods").beginObject();
+    for (n = 0; n < _methodCount; n++) {
+        message.key(_methods[n].name).beginObject();
+        message.member("calls", _methods[n].calls);
+        message.member("errors", _methods[n].errors);
+        message.key("latencyUs");
+        appendHistogramToMessage(message, _methods[n].latency);
+        message.endObject();
+    }
+    message.endObject();
+
+    message.key("scans").beginObject();
+    message.member("count", _scans);
+    message.key("durationMs");
+    appendHistogramToMessage(message, _scanDuration);
+    message.endObject();
+
+    message.key("subscriptionPosts").beginObject();
+    message.member("count", _posts);
+    /* Can't be represented as int anymore after a while */
+    message.key("bytes").raw(QByteArray::number((qulonglong) _postedBytes));
+    message.endObject();
+
+    message.key("connmanSignals").beginObject();
+    for (n = 0; n < SIGNAL_COUNT; n++)
+        message.member(signal_names[n], _signals[n]);
+    message.endObject();
+}
@@ -0,0 +1,101 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#ifndef ADAPTERMETRICS_H_
+#define ADAPTERMETRICS_H_
+
+#include <glib.h>
+
+#include "latencyhistogram.h"
+#include "jsonwriter.h"
+
+#define METRICS_MAX_METHODS     16
+
+/* Counters and latency histograms about the work the adapter does. Handler latencies
+ * are kept in microseconds, scan durations in milliseconds. */
+class AdapterMetrics
+{
+public:
+    enum ConnmanSignal {
+        SIGNAL_AVAILABILITY_CHANGED,
+        SIGNAL_TECHNOLOGIES_CHANGED,
+        SIGNAL_SERVICES_CHANGED,
+        SIGNAL_POWERED_CHANGED,
+        SIGNAL_CONNECTED_CHANGED,
+        SIGNAL_SCAN_FINISHED,
+        SIGNAL_STATE_CHANGED,
+        SIGNAL_STRENGTH_CHANGED,
+        SIGNAL_IPV4_CHANGED,
+        SIGNAL_NAME_CHANGED,
+        SIGNAL_SERVICE_CHANGED,
+        SIGNAL_COUNT
+    };
+
+    AdapterMetrics();
+    ~AdapterMetrics();
+
+    /* A handler call for the method starts or ends; calls don't nest */
+    void beginCall(const char *method);
+    void endCall();
+
+    /* A request of the method was answered with an error */
+    void countError(const char *method);
+
+    void countSignal(ConnmanSignal signal);
+    void countPost(unsigned int payloadLength);
+
+    void scanStarted();
+    void scanFinished();
+
+    /* Time it took until we knew connman's state after we started */
+    void setStartupDuration(unsigned int duration);
+
+    void appendToMessage(JsonWriter& message) const;
+
+    static void appendHistogramToMessage(JsonWriter& message, const LatencyHistogram& histogram);
+
+private:
+    struct MethodMetrics {
+        const char *name;
+        unsigned int calls;
+        unsigned int errors;
+        LatencyHistogram latency;
+    };
+
+    MethodMetrics _methods[METRICS_MAX_METHODS];
+    int _methodCount;
+    MethodMetrics *_currentCall;
+    gint64 _callStarted;
+
+    unsigned int _signals[SIGNAL_COUNT];
+
+    unsigned int _posts;
+    guint64 _postedBytes;
+
+    unsigned int _scans;
+    gint64 _scanStarted;
+    LatencyHistogram _scanDuration;
+
+    unsigned int _startupDuration;
+
+    MethodMetrics* method(const char *name);
+};
+
+#endif
@@ -0,0 +1,166 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "adaptersettings.h"
+
+/* Lower bounds for intervals which drive timers; anything shorter would keep the
+ * main loop spinning */
+#define MIN_IDLE_TIMEOUT        1000
+#define MIN_TRAILING_DELAY      100
+
+static unsigned int read_uint(GKeyFile *keyfile, const char *group, const char *key,
+                              unsigned int default_value)
+{
+    GError *error = NULL;
+    int value;
+
+    value = g_key_file_get_integer(keyfile, group, key, &error);
+    if (error) {
+        g_error_free(error);
+        return default_value;
+    }
+
+    if (value < 0)
+        return default_value;
+
+    return value;
+}
+
+/* Like read_uint() for intervals in ms which can't be turned off */
+static unsigned int read_interval(GKeyFile *keyfile, const char *group, const char *key,
+                                  unsigned int default_value, unsigned int min_value)
+{
+    unsigned int value = read_uint(keyfile, group, key, default_value);
+
+    if (value < min_value) {
+        g_warning("%s/%s of %u ms is too short; using %u ms", group, key, value, min_value);
+        return min_value;
+    }
+
+    return value;
+}
+
+static QString read_string(GKeyFile *keyfile, const char *group, const char *key,
+                           const QString& default_value)
+{
+    gchar *value;
+    QString result;
+
+    value = g_key_file_get_string(keyfile, group, key, NULL);
+    if (value == NULL)
+        return default_value;
+
+    result = QString::fromUtf8(value);
+    g_free(value);
+
+    return result;
+}
+
+static bool read_bool(GKeyFile *keyfile, const char *group, const char *key,
+                      bool default_value)
+{
+    GError *error = NULL;
+    gboolean value;
+
+    value = g_key_file_get_boolean(keyfile, group, key, &error);
+    if (error) {
+        g_error_free(error);
+        return default_value;
+    }
+
+    return value;
+}
+
+AdapterSettings::AdapterSettings()
+    : strengthPolicy(STRENGTH_POLICY_BAR_CHANGE),
+      strengthHysteresis(5),
+      strengthMinInterval(1000),
+      strengthTrailingDelay(2000),
+      connectTimeout(60000),
+      startupTimeout(3000),
+      profileStorePath("/var/lib/connman-adapter/profiles"),
+      coalesceWindow(0),
+      onDemand(false),
+      idleTimeout(60000),
+      statusFilePath("/var/lib/connman-adapter/status")
+{
+}
+
+AdapterSettings* AdapterSettings::instance()
+{
+    static AdapterSettings *settings = NULL;
+
+    if (settings == NULL) {
+        settings = new AdapterSettings();
+        settings->load(ADAPTER_SETTINGS_FILE);
+    }
+
+    return settings;
+}
+
+void AdapterSettings::load(const char *path)
+{
+    GKeyFile *keyfile;
+    gchar *policy;
+
+    keyfile = g_key_file_new();
+
+    /* Not having a settings file at all is fine; we simply stay with the defaults */
+    if (!g_key_file_load_from_file(keyfile, path, G_KEY_FILE_NONE, NULL)) {
+        g_key_file_free(keyfile);
+        return;
+    }
+
+    policy = g_key_file_get_string(keyfile, "SignalStrength", "Policy", NULL);
+    if (policy) {
+        if (!strcmp(policy, "barchange"))
+            strengthPolicy = STRENGTH_POLICY_BAR_CHANGE;
+        else if (!strcmp(policy, "hysteresis"))
+            strengthPolicy = STRENGTH_POLICY_HYSTERESIS;
+        else if (!strcmp(policy, "interval"))
+            strengthPolicy = STRENGTH_POLICY_MIN_INTERVAL;
+        else
+            g_warning("Unknown signal strength policy %s; using default", policy);
+
+        g_free(policy);
+    }
+
+    strengthHysteresis = read_uint(keyfile, "SignalStrength", "Hysteresis", strengthHysteresis);
+    strengthMinInterval = read_uint(keyfile, "SignalStrength", "MinInterval", strengthMinInterval);
+    strengthTrailingDelay = read_interval(keyfile, "SignalStrength", "TrailingDelay",
+                                          strengthTrailingDelay, MIN_TRAILING_DELAY);
+
+    connectTimeout = read_uint(keyfile, "Connect", "Timeout", connectTimeout);
+
+    startupTimeout = read_uint(keyfile, "Startup", "Timeout", startupTimeout);
+
+    profileStorePath = read_string(keyfile, "Profiles", "StorePath", profileStorePath);
+
+    coalesceWindow = read_uint(keyfile, "Status", "CoalesceWindow", coalesceWindow);
+
+    onDemand = read_bool(keyfile, "OnDemand", "Enabled", onDemand);
+    idleTimeout = read_interval(keyfile, "OnDemand", "IdleTimeout", idleTimeout, MIN_IDLE_TIMEOUT);
+    statusFilePath = read_string(keyfile, "OnDemand", "StatusFile", statusFilePath);
+
+    g_key_file_free(keyfile);
+}
@@ -0,0 +1,70 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#ifndef ADAPTERSETTINGS_H_
+#define ADAPTERSETTINGS_H_
+
+#include <QString>
+
+#define ADAPTER_SETTINGS_FILE   "/etc/connman-adapter.conf"
+
+/* Tunables of the adapter. All of them have sane defaults and can be overriden
+ * through the key file at ADAPTER_SETTINGS_FILE. */
+class AdapterSettings
+{
+public:
+    static AdapterSettings* instance();
+
+    void load(const char *path);
+
+    enum StrengthPolicy {
+        STRENGTH_POLICY_BAR_CHANGE,
+        STRENGTH_POLICY_HYSTERESIS,
+        STRENGTH_POLICY_MIN_INTERVAL,
+    };
+
+    /* [SignalStrength] */
+    StrengthPolicy strengthPolicy;
+    unsigned int strengthHysteresis;
+    unsigned int strengthMinInterval;
+    unsigned int strengthTrailingDelay;
+
+    /* [Connect] */
+    unsigned int connectTimeout;
+
+    /* [Startup] */
+    unsigned int startupTimeout;
+
+    /* [Profiles] */
+    QString profileStorePath;
+
+    /* [Status] */
+    unsigned int coalesceWindow;
+
+    /* [OnDemand] */
+    bool onDemand;
+    unsigned int idleTimeout;
+    QString statusFilePath;
+
+private:
+    AdapterSettings();
+};
+
+#endif
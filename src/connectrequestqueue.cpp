@@ -0,0 +1,169 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#include "connectrequestqueue.h"
+
+#define CONNECT_SUPERSEDED_REPLY \
+    "{\"returnValue\":false,\"errorText\":\"Superseded by another connect request\"}"
+#define CONNECT_TIMEOUT_REPLY \
+    "{\"returnValue\":false,\"errorText\":\"Timeout while connecting to network\"}"
+#define CONNECT_CANCELED_REPLY \
+    "{\"returnValue\":false,\"errorCode\":12,\"errorText\":\"NotPermitted\"}"
+
+ConnectRequestQueue::ConnectRequestQueue() :
+    _timeout(0),
+    _timeoutHandler(NULL),
+    _timeoutHandlerData(NULL)
+{
+}
+
+ConnectRequestQueue::~ConnectRequestQueue()
+{
+    foreach (Transaction *transaction, _transactions) {
+        if (transaction->timeout != 0)
+            g_source_remove(transaction->timeout);
+
+        LSMessageUnref(transaction->request.message);
+        delete transaction;
+    }
+}
+
+void ConnectRequestQueue::setTimeout(unsigned int timeout)
+{
+    _timeout = timeout;
+}
+
+void ConnectRequestQueue::setTimeoutHandler(TimeoutHandler handler, void *user_data)
+{
+    _timeoutHandler = handler;
+    _timeoutHandlerData = user_data;
+}
+
+void ConnectRequestQueue::enqueue(LSHandle *handle, LSMessage *message, const QString& servicePath)
+{
+    Transaction *transaction;
+    QList<Transaction*>::iterator iter;
+
+    /* Connman gives up on the service it was connecting to once it's asked to connect
+     * to another one so there is no point in letting those callers wait any longer */
+    iter = _transactions.begin();
+    while (iter != _transactions.end()) {
+        if ((*iter)->servicePath != servicePath) {
+            reply(*iter, CONNECT_SUPERSEDED_REPLY);
+            iter = _transactions.erase(iter);
+        }
+        else {
+            ++iter;
+        }
+    }
+
+    transaction = new Transaction;
+    transaction->queue = this;
+    transaction->request.handle = handle;
+    transaction->request.message = message;
+    transaction->request.valid = true;
+    transaction->servicePath = servicePath;
+    transaction->timeout = 0;
+
+    if (_timeout > 0)
+        transaction->timeout = g_timeout_add(_timeout, cbTimeout, transaction);
+
+    _transactions.append(transaction);
+}
+
+bool ConnectRequestQueue::hasPending(const QString& servicePath) const
+{
+    foreach (Transaction *transaction, _transactions) {
+        if (transaction->servicePath == servicePath)
+            return true;
+    }
+
+    return false;
+}
+
+void ConnectRequestQueue::complete(const QString& servicePath, const char *payload)
+{
+    QList<Transaction*>::iterator iter;
+
+    iter = _transactions.begin();
+    while (iter != _transactions.end()) {
+        if ((*iter)->servicePath == servicePath) {
+            reply(*iter, payload);
+            iter = _transactions.erase(iter);
+        }
+        else {
+            ++iter;
+        }
+    }
+}
+
+void ConnectRequestQueue::completeAll(const char *payload)
+{
+    foreach (Transaction *transaction, _transactions)
+        reply(transaction, payload);
+
+    _transactions.clear();
+}
+
+int ConnectRequestQueue::cancelAll()
+{
+    int count = _transactions.size();
+
+    completeAll(CONNECT_CANCELED_REPLY);
+
+    return count;
+}
+
+void ConnectRequestQueue::reply(Transaction *transaction, const char *payload)
+{
+    LSError lserror;
+
+    LSErrorInit(&lserror);
+
+    if (transaction->timeout != 0)
+        g_source_remove(transaction->timeout);
+
+    if (!LSMessageReply(transaction->request.handle, transaction->request.message,
+                        payload, &lserror)) {
+        LSErrorPrint(&lserror, stderr);
+        LSErrorFree(&lserror);
+    }
+
+    LSMessageUnref(transaction->request.message);
+    delete transaction;
+}
+
+gboolean ConnectRequestQueue::cbTimeout(gpointer user_data)
+{
+    Transaction *transaction = (Transaction*) user_data;
+    ConnectRequestQueue *self = transaction->queue;
+    const char *payload = CONNECT_TIMEOUT_REPLY;
+
+    /* The source is destroyed once we return so it must not be removed again */
+    transaction->timeout = 0;
+
+    if (self->_timeoutHandler != NULL)
+        payload = self->_timeoutHandler(transaction->servicePath, self->_timeoutHandlerData);
+
+    self->_transactions.removeOne(transaction);
+    self->reply(transaction, payload);
+
+    return FALSE;
+}
@@ -0,0 +1,83 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#ifndef CONNECTREQUESTQUEUE_H_
+#define CONNECTREQUESTQUEUE_H_
+
+#include <QList>
+#include <QString>
+#include <glib.h>
+#include <luna-service2/lunaservice.h>
+
+#include "servicerequest.h"
+
+/* Connect requests which are waiting for connman to associate with the service they
+ * asked for. Every request is answered exactly once: when the connect succeeds or
+ * fails, when it runs into its timeout, when a connect to another service
+ * supersedes it or when it's canceled because wifi went away. Connman only connects to one service at a time so requests for
+ * different services never stay queued next to each other. */
+class ConnectRequestQueue
+{
+public:
+    ConnectRequestQueue();
+    ~ConnectRequestQueue();
+
+    /* Timeout in milliseconds after which a request gets an error reply; 0 disables
+     * the timeout */
+    void setTimeout(unsigned int timeout);
+
+    /* Called when a request ran into its timeout; returns the payload it's answered
+     * with. Without a handler the request gets a plain error reply. */
+    typedef const char* (*TimeoutHandler)(const QString& servicePath, void *user_data);
+    void setTimeoutHandler(TimeoutHandler handler, void *user_data);
+
+    /* Takes over the reference to the message the caller holds */
+    void enqueue(LSHandle *handle, LSMessage *message, const QString& servicePath);
+
+    bool hasPending(const QString& servicePath) const;
+    bool isEmpty() const { return _transactions.isEmpty(); }
+
+    /* Answers all pending requests for the service with the provided payload */
+    void complete(const QString& servicePath, const char *payload);
+    void completeAll(const char *payload);
+
+    /* Answers all pending requests with the error callers get while wifi is off;
+     * returns how many there were */
+    int cancelAll();
+
+private:
+    struct Transaction {
+        ConnectRequestQueue *queue;
+        LunaServiceRequestData request;
+        QString servicePath;
+        guint timeout;
+    };
+
+    unsigned int _timeout;
+    TimeoutHandler _timeoutHandler;
+    void *_timeoutHandlerData;
+    QList<Transaction*> _transactions;
+
+    void reply(Transaction *transaction, const char *payload);
+
+    static gboolean cbTimeout(gpointer user_data);
+};
+
+#endif
@@ -0,0 +1,137 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#include "connecttimings.h"
+
+static const char *phase_names[ConnectTimings::PHASE_COUNT] = {
+    "requestInput",
+    "association",
+    "configuration",
+    "ready",
+    "online"
+};
+
+static const char *outcome_names[ConnectTimings::OUTCOME_COUNT] = {
+    "succeeded",
+    "failed",
+    "timedOut"
+};
+
+ConnectTimings::ConnectTimings() :
+    _requested(0)
+{
+    std::fill(_reached, _reached + PHASE_COUNT, 0);
+    std::fill(_outcomes, _outcomes + OUTCOME_COUNT, 0);
+}
+
+ConnectTimings::~ConnectTimings()
+{
+}
+
+const char* ConnectTimings::phaseName(int phase)
+{
+    return phase_names[phase];
+}
+
+const char* ConnectTimings::outcomeName(int outcome)
+{
+    return outcome_names[outcome];
+}
+
+void ConnectTimings::start(const QString& servicePath)
+{
+    if (_requested != 0)
+        finish(OUTCOME_FAILED);
+
+    _servicePath = servicePath;
+    _requested = g_get_monotonic_time();
+    std::fill(_reached, _reached + PHASE_COUNT, 0);
+}
+
+void ConnectTimings::mark(const QString& servicePath, Phase phase)
+{
+    if (!isTracking(servicePath) || _reached[phase] != 0)
+        return;
+
+    _reached[phase] = g_get_monotonic_time();
+}
+
+void ConnectTimings::finish(Outcome outcome)
+{
+    int n, value;
+
+    if (_requested == 0)
+        return;
+
+    for (n = 0; n < PHASE_COUNT; n++) {
+        value = duration(n);
+        if (value >= 0)
+            _histograms[n].add(value);
+    }
+
+    _outcomes[outcome]++;
+
+    _servicePath.clear();
+    _requested = 0;
+}
+
+bool ConnectTimings::isTracking(const QString& servicePath) const
+{
+    return _requested != 0 && _servicePath == servicePath;
+}
+
+void ConnectTimings::appendToMessage(JsonWriter& message) const
+{
+    int n, value;
+
+    message.beginObject();
+
+    for (n = 0; n < PHASE_COUNT; n++) {
+        value = duration(n);
+        if (value >= 0)
+            message.member(phase_names[n], value);
+    }
+
+    message.endObject();
+}
+
+int ConnectTimings::duration(int phase) const
+{
+    gint64 start = _requested;
+    int n;
+
+    if (_requested == 0 || _reached[phase] == 0)
+        return -1;
+
+    if (phase != PHASE_REQUEST_INPUT) {
+        for (n = phase - 1; n > PHASE_REQUEST_INPUT; n--) {
+            if (_reached[n] != 0) {
+                start = _reached[n];
+                break;
+            }
+        }
+    }
+
+    /* States don't always come in order (e.g. online before ready got through) */
+    if (_reached[phase] < start)
+        return 0;
+
+    return (_reached[phase] - start) / 1000;
+}
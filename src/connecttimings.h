@@ -0,0 +1,91 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#ifndef CONNECTTIMINGS_H_
+#define CONNECTTIMINGS_H_
+
+#include <QString>
+#include <glib.h>
+
+#include "latencyhistogram.h"
+#include "jsonwriter.h"
+
+/* Timestamps of the phases a connect attempt goes through. Every phase is measured
+ * from the end of the one before it in the order request, association,
+ * configuration (association and authentication done), ready (DHCP done) and online;
+ * a phase connman skipped is left out. The agent being asked for input is measured
+ * from the request as it happens somewhere within association. */
+class ConnectTimings
+{
+public:
+    enum Phase {
+        PHASE_REQUEST_INPUT,
+        PHASE_ASSOCIATION,
+        PHASE_CONFIGURATION,
+        PHASE_READY,
+        PHASE_ONLINE,
+        PHASE_COUNT
+    };
+
+    enum Outcome {
+        OUTCOME_SUCCEEDED,
+        OUTCOME_FAILED,
+        OUTCOME_TIMED_OUT,
+        OUTCOME_COUNT
+    };
+
+    ConnectTimings();
+    ~ConnectTimings();
+
+    static const char* phaseName(int phase);
+    static const char* outcomeName(int outcome);
+
+    /* Starts tracking an attempt for the service; a still tracked attempt is finished
+     * first as failed */
+    void start(const QString& servicePath);
+
+    /* Records the time the phase was reached; ignored for other services than the
+     * tracked one and for phases which were already reached */
+    void mark(const QString& servicePath, Phase phase);
+
+    /* Adds the durations of all reached phases to the histograms, counts the outcome
+     * and stops tracking */
+    void finish(Outcome outcome);
+
+    bool isTracking(const QString& servicePath) const;
+
+    /* Appends the durations of the reached phases of the tracked attempt as object */
+    void appendToMessage(JsonWriter& message) const;
+
+    const LatencyHistogram& histogram(int phase) const { return _histograms[phase]; }
+    unsigned int outcomeCount(int outcome) const { return _outcomes[outcome]; }
+
+private:
+    QString _servicePath;
+    gint64 _requested;
+    gint64 _reached[PHASE_COUNT];
+    LatencyHistogram _histograms[PHASE_COUNT];
+    unsigned int _outcomes[OUTCOME_COUNT];
+
+    /* Duration of the phase in milliseconds or -1 when it wasn't reached */
+    int duration(int phase) const;
+};
+
+#endif
@@ -43,7 +43,7 @@ void ConnmanAgent::Release()
 void ConnmanAgent::ReportError(const QDBusObjectPath &service_path, const QString &error)
 {
     qDebug() << "From " << service_path.path() << " got this error:\n" << error;
-    _service->processErrorFromConnman(error);
+    _service->processErrorFromConnman(service_path.path(), error);
 }
 
 void ConnmanAgent::RequestBrowser(const QDBusObjectPath &service_path, const QString &url)
@@ -57,7 +57,7 @@ void ConnmanAgent::RequestInput(const QDBusObjectPath &service_path,
     QVariantMap json;
     qDebug() << "Service " << service_path.path() << " wants user input";
 
-    _service->provideInputForConnman(fields, message);
+    _service->provideInputForConnman(service_path.path(), fields, message);
 }
 
 void ConnmanAgent::Cancel()
@@ -0,0 +1,182 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#include "connmanservicetable.h"
+#include "utilities.h"
+
+static int security_from_list(const QStringList& security)
+{
+    if (security.isEmpty())
+        return CONNMAN_SECURITY_NONE;
+
+    return parse_connman_security_type(security.first());
+}
+
+static void set_ipv4(ConnmanServiceInfo& info, const QVariantMap& ipv4)
+{
+    QStringList nameservers;
+
+    info.address = ipv4.value("Address").toString();
+    info.netmask = ipv4.value("Netmask").toString();
+    info.gateway = ipv4.value("Gateway").toString();
+
+    /* the first nameserver is the one currently used */
+    nameservers = ipv4.value("Nameservers").toStringList();
+    info.nameserver = nameservers.isEmpty() ? QString() : nameservers.first();
+}
+
+ConnmanServiceTable::ConnmanServiceTable(QObject *parent) :
+    QObject(parent)
+{
+}
+
+ConnmanServiceTable::~ConnmanServiceTable()
+{
+}
+
+void ConnmanServiceTable::update(const QList<NetworkService*>& services)
+{
+    QHash<NetworkService*, ConnmanServiceInfo> oldServices = _services;
+
+    _services.clear();
+    _names.clear();
+
+    foreach (NetworkService *service, services) {
+        ConnmanServiceInfo info;
+
+        /* Entries of services we already follow are kept up to date by the signals */
+        if (oldServices.contains(service)) {
+            info = oldServices.take(service);
+            info.name = internName(info.name);
+            _services.insert(service, info);
+            continue;
+        }
+
+        fill(info, service);
+        _services.insert(service, info);
+
+        connect(service, SIGNAL(nameChanged(QString)), this, SLOT(nameChanged(QString)), Qt::UniqueConnection);
+        connect(service, SIGNAL(stateChanged(QString)), this, SLOT(stateChanged(QString)), Qt::UniqueConnection);
+        connect(service, SIGNAL(strengthChanged(uint)), this, SLOT(strengthChanged(uint)), Qt::UniqueConnection);
+        connect(service, SIGNAL(securityChanged(QStringList)), this, SLOT(securityChanged(QStringList)), Qt::UniqueConnection);
+        connect(service, SIGNAL(favoriteChanged(bool)), this, SLOT(favoriteChanged(bool)), Qt::UniqueConnection);
+        connect(service, SIGNAL(ipv4Changed(QVariantMap)), this, SLOT(ipv4Changed(QVariantMap)), Qt::UniqueConnection);
+        connect(service, SIGNAL(destroyed(QObject*)), this, SLOT(serviceDestroyed(QObject*)), Qt::UniqueConnection);
+    }
+
+    /* Services which left the list but still exist keep their connections; their
+     * signals are ignored as long as they are out of the table */
+}
+
+const ConnmanServiceInfo* ConnmanServiceTable::find(NetworkService *service) const
+{
+    QHash<NetworkService*, ConnmanServiceInfo>::const_iterator it = _services.constFind(service);
+
+    if (it == _services.constEnd())
+        return NULL;
+
+    return &it.value();
+}
+
+ConnmanServiceInfo* ConnmanServiceTable::senderEntry()
+{
+    QHash<NetworkService*, ConnmanServiceInfo>::iterator it;
+
+    it = _services.find(static_cast<NetworkService*>(sender()));
+    if (it == _services.end())
+        return NULL;
+
+    return &it.value();
+}
+
+QString ConnmanServiceTable::internName(const QString& name)
+{
+    /* Keeps one copy of each name no matter how many services share it */
+    return *_names.insert(name);
+}
+
+void ConnmanServiceTable::fill(ConnmanServiceInfo& info, NetworkService *service)
+{
+    info.path = service->dbusPath();
+    info.name = internName(service->name());
+    info.state = parse_connman_service_state(service->state());
+    info.history.record(info.state, g_get_monotonic_time());
+    info.security = security_from_list(service->security());
+    info.strength = service->strength();
+    info.favorite = service->favorite();
+    set_ipv4(info, service->ipv4());
+}
+
+void ConnmanServiceTable::nameChanged(const QString& name)
+{
+    ConnmanServiceInfo *info = senderEntry();
+
+    if (info != NULL)
+        info->name = internName(name);
+}
+
+void ConnmanServiceTable::stateChanged(const QString& state)
+{
+    ConnmanServiceInfo *info = senderEntry();
+
+    if (info == NULL)
+        return;
+
+    info->state = parse_connman_service_state(state);
+    info->history.record(info->state, g_get_monotonic_time());
+}
+
+void ConnmanServiceTable::strengthChanged(uint strength)
+{
+    ConnmanServiceInfo *info = senderEntry();
+
+    if (info != NULL)
+        info->strength = strength;
+}
+
+void ConnmanServiceTable::securityChanged(const QStringList& security)
+{
+    ConnmanServiceInfo *info = senderEntry();
+
+    if (info != NULL)
+        info->security = security_from_list(security);
+}
+
+void ConnmanServiceTable::favoriteChanged(bool favorite)
+{
+    ConnmanServiceInfo *info = senderEntry();
+
+    if (info != NULL)
+        info->favorite = favorite;
+}
+
+void ConnmanServiceTable::ipv4Changed(const QVariantMap& ipv4)
+{
+    ConnmanServiceInfo *info = senderEntry();
+
+    if (info != NULL)
+        set_ipv4(*info, ipv4);
+}
+
+void ConnmanServiceTable::serviceDestroyed(QObject *object)
+{
+    /* A new service object might get the same address later on */
+    _services.remove(static_cast<NetworkService*>(object));
+}
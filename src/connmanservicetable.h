@@ -0,0 +1,92 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#ifndef CONNMANSERVICETABLE_H_
+#define CONNMANSERVICETABLE_H_
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVariantMap>
+#include <networkservice.h>
+
+#include "servicestatehistory.h"
+
+/* Plain copy of the service properties the com.palm.wifi API reports */
+struct ConnmanServiceInfo
+{
+    QString path;
+    /* Shared with all other services of the same name */
+    QString name;
+    /* CONNMAN_SERVICE_STATE_* and CONNMAN_SECURITY_* */
+    int state;
+    int security;
+    unsigned int strength;
+    bool favorite;
+    /* IPv4 settings; empty while the service has none */
+    QString address;
+    QString netmask;
+    QString gateway;
+    QString nameserver;
+    /* Transitions since we know about the service */
+    ServiceStateHistory history;
+};
+
+/* Keeps a ConnmanServiceInfo for each wifi service connman-qt knows about. Each entry
+ * is refreshed from the change signal of the single property which changed, so
+ * reading it while building a response costs neither a D-Bus call nor a lookup in
+ * connman-qt's property map. The table connects to a service before anybody else
+ * does, which makes its entry up to date by the time other slots for the same
+ * change run. */
+class ConnmanServiceTable : public QObject
+{
+    Q_OBJECT
+
+public:
+    ConnmanServiceTable(QObject *parent = 0);
+    virtual ~ConnmanServiceTable();
+
+    /* Takes over the services in connman's current list */
+    void update(const QList<NetworkService*>& services);
+
+    /* Returns NULL for services which aren't in the list */
+    const ConnmanServiceInfo* find(NetworkService *service) const;
+
+private slots:
+    void nameChanged(const QString& name);
+    void stateChanged(const QString& state);
+    void strengthChanged(uint strength);
+    void securityChanged(const QStringList& security);
+    void favoriteChanged(bool favorite);
+    void ipv4Changed(const QVariantMap& ipv4);
+    void serviceDestroyed(QObject *object);
+
+private:
+    QHash<NetworkService*, ConnmanServiceInfo> _services;
+    QSet<QString> _names;
+
+    ConnmanServiceInfo* senderEntry();
+    QString internName(const QString& name);
+    void fill(ConnmanServiceInfo& info, NetworkService *service);
+};
+
+#endif
@@ -0,0 +1,249 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+#include "jsonwriter.h"
+
+static const char hex_digits[] = "0123456789abcdef";
+
+JsonWriter::JsonWriter(int capacity) :
+    _length(0),
+    _depth(0),
+    _afterKey(false)
+{
+    /* The buffer is never shrunk again: resizing a QByteArray to 0 would free it */
+    _buffer.resize(capacity > 0 ? capacity : 1);
+    _buffer.data()[0] = '\0';
+    _needsSeparator[0] = false;
+}
+
+JsonWriter::~JsonWriter()
+{
+}
+
+void JsonWriter::reset()
+{
+    _length = 0;
+    _buffer.data()[0] = '\0';
+    _depth = 0;
+    _needsSeparator[0] = false;
+    _afterKey = false;
+}
+
+void JsonWriter::append(const char *str, int length)
+{
+    /* Leaves room for the terminating NUL */
+    if (_length + length + 1 > _buffer.size())
+        _buffer.resize(qMax(_buffer.size() * 2, _length + length + 1));
+
+    memcpy(_buffer.data() + _length, str, length);
+    _length += length;
+    _buffer.data()[_length] = '\0';
+}
+
+void JsonWriter::separate()
+{
+    /* A value following its key never needs a separator */
+    if (_afterKey) {
+        _afterKey = false;
+        return;
+    }
+
+    if (_needsSeparator[_depth])
+        append(',');
+
+    _needsSeparator[_depth] = true;
+}
+
+JsonWriter& JsonWriter::beginObject()
+{
+    separate();
+    append('{');
+
+    if (_depth + 1 < JSON_WRITER_MAX_DEPTH)
+        _depth++;
+    _needsSeparator[_depth] = false;
+
+    return *this;
+}
+
+JsonWriter& JsonWriter::endObject()
+{
+    if (_depth > 0)
+        _depth--;
+    append('}');
+
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray()
+{
+    separate();
+    append('[');
+
+    if (_depth + 1 < JSON_WRITER_MAX_DEPTH)
+        _depth++;
+    _needsSeparator[_depth] = false;
+
+    return *this;
+}
+
+JsonWriter& JsonWriter::endArray()
+{
+    if (_depth > 0)
+        _depth--;
+    append(']');
+
+    return *this;
+}
+
+JsonWriter& JsonWriter::key(const char *name)
+{
+    separate();
+    appendString(name, strlen(name));
+    append(':');
+    _afterKey = true;
+
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(const char *str)
+{
+    separate();
+
+    if (str == NULL)
+        append("null", 4);
+    else
+        appendString(str, strlen(str));
+
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(const QString& str)
+{
+    QByteArray utf8 = str.toUtf8();
+
+    separate();
+    appendString(utf8.constData(), utf8.length());
+
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(int number)
+{
+    char digits[16];
+    int length;
+
+    separate();
+
+    length = snprintf(digits, sizeof(digits), "%d", number);
+    append(digits, length);
+
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(unsigned int number)
+{
+    char digits[16];
+    int length;
+
+    separate();
+
+    length = snprintf(digits, sizeof(digits), "%u", number);
+    append(digits, length);
+
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(bool boolean)
+{
+    separate();
+
+    if (boolean)
+        append("true", 4);
+    else
+        append("false", 5);
+
+    return *this;
+}
+
+JsonWriter& JsonWriter::raw(const QByteArray& json)
+{
+    separate();
+    append(json.constData(), json.length());
+
+    return *this;
+}
+
+void JsonWriter::appendString(const char *str, int length)
+{
+    const char *start = str;
+    const char *end = str + length;
+    const char *current;
+    unsigned char c;
+
+    append('"');
+
+    /* Copy runs of characters which don't need escaping in one go. Everything not
+     * ASCII is valid UTF-8 already and can be passed through as it is. */
+    for (current = str; current < end; current++) {
+        c = (unsigned char) *current;
+
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+
+        append(start, current - start);
+        start = current + 1;
+
+        switch (c) {
+        case '"':
+            append("\\\"", 2);
+            break;
+        case '\\':
+            append("\\\\", 2);
+            break;
+        case '\b':
+            append("\\b", 2);
+            break;
+        case '\f':
+            append("\\f", 2);
+            break;
+        case '\n':
+            append("\\n", 2);
+            break;
+        case '\r':
+            append("\\r", 2);
+            break;
+        case '\t':
+            append("\\t", 2);
+            break;
+        default:
+            append("\\u00", 4);
+            append(hex_digits[c >> 4]);
+            append(hex_digits[c & 0xf]);
+            break;
+        }
+    }
+
+    append(start, current - start);
+    append('"');
+}
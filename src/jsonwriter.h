@@ -0,0 +1,85 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#ifndef JSONWRITER_H_
+#define JSONWRITER_H_
+
+#include <QByteArray>
+#include <QString>
+
+#define JSON_WRITER_MAX_DEPTH       16
+
+/* Writes JSON text straight into a buffer which keeps its capacity between two
+ * messages. The caller is responsible to produce a well formed document; the writer
+ * only takes care about separators and string escaping. */
+class JsonWriter
+{
+public:
+    JsonWriter(int capacity = 256);
+    ~JsonWriter();
+
+    /* Forget the current content but keep the allocated buffer */
+    void reset();
+
+    JsonWriter& beginObject();
+    JsonWriter& endObject();
+    JsonWriter& beginArray();
+    JsonWriter& endArray();
+
+    JsonWriter& key(const char *name);
+
+    JsonWriter& value(const char *str);
+    JsonWriter& value(const QString& str);
+    JsonWriter& value(int number);
+    JsonWriter& value(unsigned int number);
+    JsonWriter& value(bool boolean);
+
+    /* Appends an already serialized JSON value as it is */
+    JsonWriter& raw(const QByteArray& json);
+
+    JsonWriter& member(const char *name, const char *str) { return key(name).value(str); }
+    JsonWriter& member(const char *name, const QString& str) { return key(name).value(str); }
+    JsonWriter& member(const char *name, int number) { return key(name).value(number); }
+    JsonWriter& member(const char *name, unsigned int number) { return key(name).value(number); }
+    JsonWriter& member(const char *name, bool boolean) { return key(name).value(boolean); }
+
+    /* The content is NUL terminated and valid until the next change of the writer */
+    const char* data() const { return _buffer.constData(); }
+    int length() const { return _length; }
+
+    /* Copy of the content which stays valid after the writer is reset */
+    QByteArray toByteArray() const { return QByteArray(_buffer.constData(), _length); }
+
+private:
+    /* Only the first _length bytes are content; the rest is kept allocated for the
+     * next message */
+    QByteArray _buffer;
+    int _length;
+    int _depth;
+    bool _needsSeparator[JSON_WRITER_MAX_DEPTH];
+    bool _afterKey;
+
+    void append(const char *str, int length);
+    void append(char c) { append(&c, 1); }
+    void separate();
+    void appendString(const char *str, int length);
+};
+
+#endif
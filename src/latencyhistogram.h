@@ -0,0 +1,107 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#ifndef LATENCYHISTOGRAM_H_
+#define LATENCYHISTOGRAM_H_
+
+#include <algorithm>
+#include <vector>
+
+#define LATENCY_HISTOGRAM_SAMPLES   256
+#define LATENCY_HISTOGRAM_BUCKETS   21
+
+/* Distribution of the last LATENCY_HISTOGRAM_SAMPLES latencies. Older samples drop
+ * out of the buckets again once they are pushed out of the ring. Buckets are
+ * logarithmic and don't care about the unit: bucket n takes the values below 2^n
+ * which didn't fit into bucket n - 1, the last one takes everything above. */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram() : _next(0), _count(0)
+    {
+        std::fill(_buckets, _buckets + LATENCY_HISTOGRAM_BUCKETS, 0);
+    }
+
+    ~LatencyHistogram() { }
+
+    void add(unsigned int latency)
+    {
+        if (_count == LATENCY_HISTOGRAM_SAMPLES)
+            _buckets[bucketFor(_samples[_next])]--;
+        else
+            _count++;
+
+        _samples[_next] = latency;
+        _buckets[bucketFor(latency)]++;
+
+        _next = (_next + 1) % LATENCY_HISTOGRAM_SAMPLES;
+    }
+
+    unsigned int count() const
+    {
+        return _count;
+    }
+
+    unsigned int bucket(int index) const
+    {
+        return _buckets[index];
+    }
+
+    /* Inclusive upper bound of the bucket; 0 for the last one as it has none */
+    static unsigned int bucketBound(int index)
+    {
+        return index < LATENCY_HISTOGRAM_BUCKETS - 1 ? (1u << index) - 1 : 0;
+    }
+
+    /* Exact percentile over the samples in the window; 0 when there are none */
+    unsigned int percentile(unsigned int percent) const
+    {
+        std::vector<unsigned int> samples(_samples, _samples + _count);
+        unsigned int index;
+
+        if (_count == 0)
+            return 0;
+
+        index = (_count - 1) * percent / 100;
+        std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+
+        return samples[index];
+    }
+
+private:
+    unsigned int _samples[LATENCY_HISTOGRAM_SAMPLES];
+    unsigned int _buckets[LATENCY_HISTOGRAM_BUCKETS];
+    unsigned int _next;
+    unsigned int _count;
+
+    static int bucketFor(unsigned int latency)
+    {
+        int n = 0;
+
+        while (latency != 0 && n < LATENCY_HISTOGRAM_BUCKETS - 1) {
+            latency >>= 1;
+            n++;
+        }
+
+        return n;
+    }
+};
+
+#endif
@@ -0,0 +1,50 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#ifndef NETWORKLISTOPTIONS_H_
+#define NETWORKLISTOPTIONS_H_
+
+/* How a findnetworks caller wants the list of networks: which ones, in which order
+ * and which part of it */
+struct NetworkListOptions
+{
+    enum SortBy {
+        SORT_NONE,
+        SORT_SIGNAL,
+        SORT_NAME,
+        SORT_PROFILE_FIRST
+    };
+
+    NetworkListOptions() : sortBy(SORT_NONE), limit(-1), offset(0), minSignalLevel(0) { }
+
+    /* The plain list in connman's order */
+    bool isDefault() const
+    {
+        return sortBy == SORT_NONE && limit < 0 && offset == 0 && minSignalLevel == 0;
+    }
+
+    SortBy sortBy;
+    /* -1 for no limit */
+    int limit;
+    int offset;
+    unsigned int minSignalLevel;
+};
+
+#endif
@@ -0,0 +1,173 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include <QByteArray>
+
+#include "profilestore.h"
+
+/* Splits the next tab or newline terminated field off the line */
+static const char* next_field(const char *start, const char *end, QByteArray& field)
+{
+    const char *separator = start;
+
+    while (separator < end && *separator != '\t')
+        separator++;
+
+    field = QByteArray(start, separator - start);
+
+    return separator < end ? separator + 1 : end;
+}
+
+ProfileStore::ProfileStore()
+{
+}
+
+ProfileStore::~ProfileStore()
+{
+}
+
+void ProfileStore::setPath(const QString& path)
+{
+    _path = path;
+}
+
+bool ProfileStore::load(QList<ProfileRecord>& records, int& nextId) const
+{
+    GMappedFile *file;
+    GError *error = NULL;
+    const char *contents, *end, *line, *lineEnd;
+    QList<ProfileRecord> loaded;
+    QByteArray version, next, id, identifier, security, name;
+    ProfileRecord record;
+    bool valid = false;
+    bool validId;
+    int lineNumber = 0;
+
+    if (_path.isEmpty())
+        return false;
+
+    file = g_mapped_file_new(_path.toUtf8().constData(), FALSE, &error);
+    if (file == NULL) {
+        if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+            g_warning("Failed to open profile index %s: %s", _path.toUtf8().constData(), error->message);
+        g_error_free(error);
+        return false;
+    }
+
+    contents = g_mapped_file_get_contents(file);
+    end = contents + g_mapped_file_get_length(file);
+
+    /* Without a valid header we can't tell what the file is. A bad record only costs
+     * us that profile. */
+    for (line = contents; line < end; line = lineEnd + 1) {
+        lineNumber++;
+
+        lineEnd = (const char*) memchr(line, '\n', end - line);
+        if (lineEnd == NULL) {
+            /* Every line we write is terminated; this one was cut off */
+            g_warning("Ignoring truncated line %d of profile index %s", lineNumber,
+                      _path.toUtf8().constData());
+            break;
+        }
+
+        if (line == contents) {
+            next_field(next_field(line, lineEnd, version), lineEnd, next);
+            valid = version.toInt() == PROFILE_STORE_VERSION && next.toInt() > 0;
+            if (!valid)
+                break;
+            continue;
+        }
+
+        line = next_field(line, lineEnd, id);
+        line = next_field(line, lineEnd, identifier);
+        line = next_field(line, lineEnd, security);
+        next_field(line, lineEnd, name);
+
+        record.id = id.toInt(&validId);
+        record.identifier = QString::fromUtf8(identifier.constData(), identifier.length());
+        record.security = QString::fromUtf8(security.constData(), security.length());
+        record.name = QString::fromUtf8(QByteArray::fromHex(name));
+
+        if (!validId || record.id <= 0 || record.identifier.isEmpty()) {
+            g_warning("Ignoring invalid line %d of profile index %s", lineNumber,
+                      _path.toUtf8().constData());
+            continue;
+        }
+
+        loaded.append(record);
+    }
+
+    g_mapped_file_unref(file);
+
+    if (!valid) {
+        g_warning("Ignoring invalid profile index %s", _path.toUtf8().constData());
+        return false;
+    }
+
+    records = loaded;
+    nextId = next.toInt();
+
+    return true;
+}
+
+bool ProfileStore::save(const QList<ProfileRecord>& records, int nextId) const
+{
+    QByteArray contents;
+    QByteArray path = _path.toUtf8();
+    GError *error = NULL;
+    gchar *directory;
+
+    if (_path.isEmpty())
+        return false;
+
+    contents.reserve(32 + records.size() * 96);
+
+    contents.append(QByteArray::number(PROFILE_STORE_VERSION));
+    contents.append('\t');
+    contents.append(QByteArray::number(nextId));
+    contents.append('\n');
+
+    foreach (const ProfileRecord& record, records) {
+        contents.append(QByteArray::number(record.id));
+        contents.append('\t');
+        contents.append(record.identifier.toUtf8());
+        contents.append('\t');
+        contents.append(record.security.toUtf8());
+        contents.append('\t');
+        contents.append(record.name.toUtf8().toHex());
+        contents.append('\n');
+    }
+
+    directory = g_path_get_dirname(path.constData());
+    g_mkdir_with_parents(directory, 0700);
+    g_free(directory);
+
+    /* Writes to a temporary file which is renamed over the old index */
+    if (!g_file_set_contents(path.constData(), contents.constData(), contents.length(), &error)) {
+        g_warning("Failed to write profile index %s: %s", path.constData(), error->message);
+        g_error_free(error);
+        return false;
+    }
+
+    return true;
+}
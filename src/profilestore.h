@@ -0,0 +1,60 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#ifndef PROFILESTORE_H_
+#define PROFILESTORE_H_
+
+#include <QList>
+#include <QString>
+
+#define PROFILE_STORE_VERSION   1
+
+/* What we remember about a profile across restarts. The identifier is the last
+ * element of the D-Bus path of the connman service which connman keeps stable. */
+struct ProfileRecord
+{
+    int id;
+    QString identifier;
+    QString name;
+    QString security;
+};
+
+/* On-disk index of our profiles. The file starts with a header line with format
+ * version and the next free profile id, followed by one line per profile with id,
+ * identifier, security and the hex encoded name separated by tabs. It's replaced
+ * atomically on every save so a crash leaves either the old or the new index. */
+class ProfileStore
+{
+public:
+    ProfileStore();
+    ~ProfileStore();
+
+    void setPath(const QString& path);
+
+    /* Returns false when there is no usable index; records and nextId are left
+     * untouched then */
+    bool load(QList<ProfileRecord>& records, int& nextId) const;
+    bool save(const QList<ProfileRecord>& records, int nextId) const;
+
+private:
+    QString _path;
+};
+
+#endif
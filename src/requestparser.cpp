@@ -0,0 +1,572 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "requestparser.h"
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/* Decodes the content of a string which was validated while parsing so we can rely
+ * on the escape sequences being complete */
+static QString decode_string(const char *start, int length)
+{
+    const char *current;
+    const char *end;
+    const char *run;
+    QString result;
+    ushort code;
+
+    current = start;
+    end = start + length;
+    run = current;
+
+    while (current < end) {
+        if (*current != '\\') {
+            current++;
+            continue;
+        }
+
+        result.append(QString::fromUtf8(run, current - run));
+        current++;
+
+        switch (*current) {
+        case 'b':
+            result.append(QChar('\b'));
+            break;
+        case 'f':
+            result.append(QChar('\f'));
+            break;
+        case 'n':
+            result.append(QChar('\n'));
+            break;
+        case 'r':
+            result.append(QChar('\r'));
+            break;
+        case 't':
+            result.append(QChar('\t'));
+            break;
+        case 'u':
+            /* surrogate pairs arrive as two escapes and end up as two UTF-16 units
+             * which is exactly what QString wants */
+            code = (hex_value(current[1]) << 12) | (hex_value(current[2]) << 8) |
+                   (hex_value(current[3]) << 4) | hex_value(current[4]);
+            result.append(QChar(code));
+            current += 4;
+            break;
+        default:
+            result.append(QChar(*current));
+            break;
+        }
+
+        current++;
+        run = current;
+    }
+
+    result.append(QString::fromUtf8(run, current - run));
+
+    return result;
+}
+
+RequestParser::RequestParser(const Field *fields, int count) :
+    _fields(fields),
+    _count(count),
+    _cursor(NULL),
+    _pathLength(0),
+    _pathTruncated(false),
+    _malformed(false)
+{
+    /* Fields beyond the limit would silently never be found */
+    if (_count > REQUEST_PARSER_MAX_FIELDS)
+        qFatal("RequestParser: %d fields exceed the limit of %d", count, REQUEST_PARSER_MAX_FIELDS);
+
+    memset(_values, 0, sizeof(_values));
+    _path[0] = '\0';
+}
+
+RequestParser::~RequestParser()
+{
+}
+
+bool RequestParser::parse(const char *payload)
+{
+    memset(_values, 0, sizeof(_values));
+    _errorText.clear();
+    _malformed = false;
+    _path[0] = '\0';
+    _pathLength = 0;
+    _pathTruncated = false;
+    _cursor = payload;
+
+    if (payload == NULL)
+        return failMalformed();
+
+    skipWhitespace();
+
+    if (*_cursor != '{' || !parseObject(0))
+        return _errorText.isEmpty() ? failMalformed() : false;
+
+    skipWhitespace();
+
+    if (*_cursor != '\0')
+        return failMalformed();
+
+    return true;
+}
+
+bool RequestParser::fail(const QString& errorText)
+{
+    _errorText = errorText;
+    return false;
+}
+
+bool RequestParser::failMalformed()
+{
+    _malformed = true;
+    return fail("InvalidRequest");
+}
+
+void RequestParser::skipWhitespace()
+{
+    while (*_cursor == ' ' || *_cursor == '\t' || *_cursor == '\n' || *_cursor == '\r')
+        _cursor++;
+}
+
+int RequestParser::findField() const
+{
+    int n;
+
+    if (_pathTruncated)
+        return -1;
+
+    for (n = 0; n < _count; n++) {
+        if (!strcmp(_fields[n].path, _path))
+            return n;
+    }
+
+    return -1;
+}
+
+bool RequestParser::parseValue(int depth)
+{
+    int field = findField();
+    const char *start = _cursor;
+    int length = 0;
+    bool integral = true;
+    FieldType type;
+
+    if (depth > REQUEST_PARSER_MAX_DEPTH)
+        return false;
+
+    switch (*_cursor) {
+    case '{':
+        type = FIELD_OBJECT;
+        if (!parseObject(depth))
+            return false;
+        length = _cursor - start;
+        break;
+    case '[':
+        /* we don't support any fields inside of arrays so they are only validated */
+        if (field < 0)
+            return parseArray(depth);
+
+        if (_fields[field].type != FIELD_STRING_ARRAY || !parseStringArray())
+            return fail(QString("Invalid value for parameter %1").arg(_fields[field].path));
+
+        type = FIELD_STRING_ARRAY;
+        length = _cursor - start;
+        break;
+    case '"':
+        type = FIELD_STRING;
+        if (!parseString(&start, &length))
+            return false;
+        break;
+    case 't':
+        type = FIELD_BOOL;
+        if (!parseLiteral("true"))
+            return false;
+        length = 4;
+        break;
+    case 'f':
+        type = FIELD_BOOL;
+        if (!parseLiteral("false"))
+            return false;
+        length = 5;
+        break;
+    case 'n':
+        /* a null value is treated as if the field wasn't there at all */
+        return parseLiteral("null");
+    default:
+        type = FIELD_INT;
+        if (!parseNumber(&integral))
+            return false;
+        length = _cursor - start;
+        break;
+    }
+
+    if (field < 0)
+        return true;
+
+    /* intValue() would silently cut off a fraction, ignore an exponent or truncate a
+     * value which doesn't fit */
+    if (type != _fields[field].type || !integral ||
+        (type == FIELD_INT && !fitsInt(start)))
+        return fail(QString("Invalid value for parameter %1").arg(_fields[field].path));
+
+    _values[field].start = start;
+    _values[field].length = length;
+    _values[field].present = true;
+
+    return true;
+}
+
+bool RequestParser::fitsInt(const char *start) const
+{
+    long value;
+
+    errno = 0;
+    value = strtol(start, NULL, 10);
+
+    return errno != ERANGE && value >= INT_MIN && value <= INT_MAX;
+}
+
+bool RequestParser::parseObject(int depth)
+{
+    const char *key;
+    int keyLength;
+    int parentPathLength;
+    bool parentPathTruncated;
+
+    /* skip the opening brace */
+    _cursor++;
+
+    skipWhitespace();
+    if (*_cursor == '}') {
+        _cursor++;
+        return true;
+    }
+
+    while (true) {
+        skipWhitespace();
+
+        if (*_cursor != '"' || !parseString(&key, &keyLength))
+            return false;
+
+        skipWhitespace();
+        if (*_cursor != ':')
+            return false;
+        _cursor++;
+        skipWhitespace();
+
+        /* Extend the path by the key of this member for the time we're looking at
+         * its value */
+        parentPathLength = _pathLength;
+        parentPathTruncated = _pathTruncated;
+
+        if (_pathLength + keyLength + 2 > REQUEST_PARSER_MAX_PATH) {
+            _pathTruncated = true;
+        }
+        else {
+            if (_pathLength > 0)
+                _path[_pathLength++] = '.';
+            memcpy(_path + _pathLength, key, keyLength);
+            _pathLength += keyLength;
+            _path[_pathLength] = '\0';
+        }
+
+        if (!parseValue(depth + 1))
+            return false;
+
+        _pathLength = parentPathLength;
+        _pathTruncated = parentPathTruncated;
+        _path[_pathLength] = '\0';
+
+        skipWhitespace();
+        if (*_cursor == ',') {
+            _cursor++;
+            continue;
+        }
+
+        if (*_cursor == '}') {
+            _cursor++;
+            return true;
+        }
+
+        return false;
+    }
+}
+
+bool RequestParser::parseArray(int depth)
+{
+    /* skip the opening bracket */
+    _cursor++;
+
+    skipWhitespace();
+    if (*_cursor == ']') {
+        _cursor++;
+        return true;
+    }
+
+    /* Values inside an array never match a field as we don't extend the path for
+     * them; hide the array's own path so they can't be taken for it */
+    _pathTruncated = true;
+
+    while (true) {
+        skipWhitespace();
+
+        if (!parseValue(depth + 1))
+            return false;
+
+        skipWhitespace();
+        if (*_cursor == ',') {
+            _cursor++;
+            continue;
+        }
+
+        if (*_cursor == ']') {
+            _cursor++;
+            break;
+        }
+
+        return false;
+    }
+
+    /* the caller restores the path state once the value is complete */
+    return true;
+}
+
+bool RequestParser::parseStringArray()
+{
+    const char *start;
+    int length;
+
+    /* skip the opening bracket */
+    _cursor++;
+
+    skipWhitespace();
+    if (*_cursor == ']') {
+        _cursor++;
+        return true;
+    }
+
+    while (true) {
+        skipWhitespace();
+
+        if (*_cursor != '"' || !parseString(&start, &length))
+            return false;
+
+        skipWhitespace();
+        if (*_cursor == ',') {
+            _cursor++;
+            continue;
+        }
+
+        if (*_cursor == ']') {
+            _cursor++;
+            return true;
+        }
+
+        return false;
+    }
+}
+
+bool RequestParser::parseString(const char **start, int *length)
+{
+    int n;
+
+    /* skip the opening quote */
+    _cursor++;
+    *start = _cursor;
+
+    while (*_cursor != '"') {
+        if ((unsigned char) *_cursor < 0x20)
+            return false;
+
+        if (*_cursor == '\\') {
+            _cursor++;
+
+            switch (*_cursor) {
+            case '"':
+            case '\\':
+            case '/':
+            case 'b':
+            case 'f':
+            case 'n':
+            case 'r':
+            case 't':
+                break;
+            case 'u':
+                for (n = 1; n <= 4; n++) {
+                    if (hex_value(_cursor[n]) < 0)
+                        return false;
+                }
+                _cursor += 4;
+                break;
+            default:
+                return false;
+            }
+        }
+
+        _cursor++;
+    }
+
+    *length = _cursor - *start;
+
+    /* skip the closing quote */
+    _cursor++;
+
+    return true;
+}
+
+bool RequestParser::parseNumber(bool *integral)
+{
+    const char *start;
+
+    *integral = true;
+
+    if (*_cursor == '-')
+        _cursor++;
+
+    start = _cursor;
+    while (*_cursor >= '0' && *_cursor <= '9')
+        _cursor++;
+
+    if (_cursor == start)
+        return false;
+
+    if (*_cursor == '.') {
+        *integral = false;
+        _cursor++;
+        start = _cursor;
+        while (*_cursor >= '0' && *_cursor <= '9')
+            _cursor++;
+
+        if (_cursor == start)
+            return false;
+    }
+
+    if (*_cursor == 'e' || *_cursor == 'E') {
+        *integral = false;
+        _cursor++;
+        if (*_cursor == '+' || *_cursor == '-')
+            _cursor++;
+
+        start = _cursor;
+        while (*_cursor >= '0' && *_cursor <= '9')
+            _cursor++;
+
+        if (_cursor == start)
+            return false;
+    }
+
+    return true;
+}
+
+bool RequestParser::parseLiteral(const char *literal)
+{
+    int length = strlen(literal);
+
+    if (strncmp(_cursor, literal, length) != 0)
+        return false;
+
+    _cursor += length;
+
+    return true;
+}
+
+bool RequestParser::has(int field) const
+{
+    if (field < 0 || field >= _count)
+        return false;
+
+    return _values[field].present;
+}
+
+QString RequestParser::stringValue(int field) const
+{
+    if (!has(field) || _fields[field].type != FIELD_STRING)
+        return QString();
+
+    return decode_string(_values[field].start, _values[field].length);
+}
+
+QStringList RequestParser::stringListValue(int field) const
+{
+    const char *current;
+    const char *end;
+    const char *start;
+    QStringList result;
+
+    if (!has(field) || _fields[field].type != FIELD_STRING_ARRAY)
+        return result;
+
+    current = _values[field].start;
+    end = current + _values[field].length;
+
+    /* Everything between the strings is punctuation or whitespace */
+    while (current < end) {
+        if (*current != '"') {
+            current++;
+            continue;
+        }
+
+        start = ++current;
+        while (*current != '"') {
+            if (*current == '\\')
+                current++;
+            current++;
+        }
+
+        result.append(decode_string(start, current - start));
+        current++;
+    }
+
+    return result;
+}
+
+int RequestParser::intValue(int field) const
+{
+    if (!has(field) || _fields[field].type != FIELD_INT)
+        return 0;
+
+    /* the value is followed by a delimiter so strtol stops at its end; parse()
+     * made sure it's in range */
+    return (int) strtol(_values[field].start, NULL, 10);
+}
+
+bool RequestParser::boolValue(int field) const
+{
+    if (!has(field) || _fields[field].type != FIELD_BOOL)
+        return false;
+
+    return _values[field].start[0] == 't';
+}
@@ -0,0 +1,109 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#ifndef REQUESTPARSER_H_
+#define REQUESTPARSER_H_
+
+#include <QString>
+#include <QStringList>
+
+#define REQUEST_PARSER_MAX_FIELDS   16
+#define REQUEST_PARSER_MAX_PATH     128
+#define REQUEST_PARSER_MAX_DEPTH    8
+
+/* Number of entries of a field table */
+#define FIELD_COUNT(fields)     ((int) (sizeof(fields) / sizeof(fields[0])))
+
+/* Parses a request payload in place against a table of the fields a method is
+ * interested in. Nested fields are addressed by their dotted path (for example
+ * "security.simpleSecurity.passKey"). No document is built: for every field only the
+ * location of its value inside the payload is remembered and converted when asked
+ * for, so the payload has to stay valid as long as the parser is used. */
+class RequestParser
+{
+public:
+    enum FieldType {
+        FIELD_STRING,
+        FIELD_INT,
+        FIELD_BOOL,
+        FIELD_OBJECT,
+        FIELD_STRING_ARRAY
+    };
+
+    struct Field {
+        const char *path;
+        FieldType type;
+    };
+
+    /* At most REQUEST_PARSER_MAX_FIELDS fields; more are a programming error and
+     * abort */
+    RequestParser(const Field *fields, int count);
+    ~RequestParser();
+
+    /* Returns false when the payload isn't a valid JSON object or one of the fields
+     * has a value of the wrong type; errorText() tells what was wrong */
+    bool parse(const char *payload);
+
+    const QString& errorText() const { return _errorText; }
+
+    /* Whether parse() failed because the payload isn't valid JSON at all rather than
+     * because of a field with a value of the wrong type */
+    bool isMalformed() const { return _malformed; }
+
+    bool has(int field) const;
+    QString stringValue(int field) const;
+    int intValue(int field) const;
+    bool boolValue(int field) const;
+    QStringList stringListValue(int field) const;
+
+private:
+    struct Value {
+        const char *start;
+        int length;
+        bool present;
+    };
+
+    const Field *_fields;
+    int _count;
+    Value _values[REQUEST_PARSER_MAX_FIELDS];
+
+    const char *_cursor;
+    char _path[REQUEST_PARSER_MAX_PATH];
+    int _pathLength;
+    bool _pathTruncated;
+    QString _errorText;
+    bool _malformed;
+
+    bool fail(const QString& errorText);
+    bool failMalformed();
+    void skipWhitespace();
+    int findField() const;
+
+    bool parseValue(int depth);
+    bool parseObject(int depth);
+    bool parseArray(int depth);
+    bool parseStringArray();
+    bool parseString(const char **start, int *length);
+    bool parseNumber(bool *integral);
+    bool fitsInt(const char *start) const;
+    bool parseLiteral(const char *literal);
+};
+
+#endif
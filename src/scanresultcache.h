@@ -0,0 +1,77 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#ifndef SCANRESULTCACHE_H_
+#define SCANRESULTCACHE_H_
+
+#include <glib.h>
+
+/* Keeps the already built findnetworks entry for each visible service together with
+ * the time the last scan completed. Entries are dropped one by one whenever the
+ * service they describe changes, so a fresh enough cache can be used to answer
+ * findnetworks without asking connman for another scan. */
+class ScanResultCache
+{
+public:
+    ScanResultCache() : _lastScanCompleted(0) { }
+    ~ScanResultCache() { }
+
+    void markScanCompleted()
+    {
+        _lastScanCompleted = g_get_monotonic_time();
+    }
+
+    /* maxAge is given in milliseconds */
+    bool isFresh(int maxAge) const
+    {
+        if (_lastScanCompleted == 0 || maxAge < 0)
+            return false;
+
+        return (g_get_monotonic_time() - _lastScanCompleted) <= (gint64) maxAge * 1000;
+    }
+
+    /* Returns a null byte array when there is no entry for the path */
+    QByteArray entry(const QString& path) const
+    {
+        return _entries.value(path);
+    }
+
+    void setEntry(const QString& path, const QByteArray& entry)
+    {
+        _entries.insert(path, entry);
+    }
+
+    void invalidate(const QString& path)
+    {
+        _entries.remove(path);
+    }
+
+    void clear()
+    {
+        _entries.clear();
+        _lastScanCompleted = 0;
+    }
+
+private:
+    gint64 _lastScanCompleted;
+    QHash<QString, QByteArray> _entries;
+};
+
+#endif
@@ -21,96 +21,224 @@
 #ifndef SERVICEPROFILE_H_
 #define SERVICEPROFILE_H_
 
+#include <glib.h>
+
+#include "profilestore.h"
+
+#define CONNMAN_SERVICE_PATH_PREFIX     "/net/connman/service/"
+
+/* Changes are written to the store at most this often (ms) */
+#define PROFILE_SAVE_DELAY              500
+/* Beyond this many profiles the oldest ones of networks out of range are dropped */
+#define PROFILE_LIST_MAX_SIZE           64
+
+/* A network we know how to connect to. The connman service behind it is only
+ * available while the network is in range; name and security are remembered so the
+ * profile can be reported without it. */
 class ServiceProfile
 {
 public:
     ServiceProfile(NetworkService *service, int id)
         : _service(service),
+          _dbusPath(service->dbusPath()),
           _id(id)
+    {
+        updateFromService();
+    }
+
+    ServiceProfile(const ProfileRecord& record)
+        : _service(NULL),
+          _dbusPath(QString(CONNMAN_SERVICE_PATH_PREFIX) + record.identifier),
+          _id(record.id),
+          _name(record.name),
+          _security(record.security)
     {
     }
 
     ~ServiceProfile() { }
 
-    QString dbusPath()
+    /* The path of a connman service never changes so we can remember it once instead
+     * of asking the service object for it each time */
+    const QString& dbusPath() const
     {
-        return _service->dbusPath();
+        return _dbusPath;
     }
 
-    int id()
+    int id() const
     {
         return _id;
     }
 
+    const QString& name() const
+    {
+        return _name;
+    }
+
+    /* Security as named by connman */
+    const QString& security() const
+    {
+        return _security;
+    }
+
+    /* NULL while the network is out of range */
     NetworkService* service() {
         return _service;
     }
 
+    void setService(NetworkService *service)
+    {
+        _service = service;
+    }
+
+    /* Takes over name and security of the service; returns true if they changed */
+    bool updateFromService()
+    {
+        QString name = _service->name();
+        QString security = _service->security().isEmpty() ? QString() : _service->security().first();
+
+        /* Hidden networks have no name until we're connected to them */
+        if (name.isEmpty())
+            name = _name;
+
+        if (name == _name && security == _security)
+            return false;
+
+        _name = name;
+        _security = security;
+
+        return true;
+    }
+
+    ProfileRecord record() const
+    {
+        ProfileRecord record;
+
+        record.id = _id;
+        record.identifier = _dbusPath.mid(_dbusPath.lastIndexOf('/') + 1);
+        record.name = _name;
+        record.security = _security;
+
+        return record;
+    }
+
 private:
     NetworkService *_service;
+    QString _dbusPath;
     int _id;
+    QString _name;
+    QString _security;
 };
 
 
+/* Profiles are indexed by their id and by the D-Bus path of their service so both
+ * lookups are constant time. The list is kept next to the indexes to report the
+ * profiles in the order they were created. Changes are written to the profile store
+ * shortly after they happen, one write for a whole batch of them, so ids stay the
+ * same when we're restarted. */
 class ServiceProfileList
 {
 public:
-    ServiceProfileList() : _lastProfileId(1) { }
-    ~ServiceProfileList() { }
+    ServiceProfileList() : _lastProfileId(1), _saveTimeout(0) { }
+
+    ~ServiceProfileList()
+    {
+        flush();
+        qDeleteAll(_profiles);
+    }
+
+    /* Restores the profiles from the store; meant to be called once before any
+     * profile is created */
+    void load(const QString& path)
+    {
+        QList<ProfileRecord> records;
+
+        _store.setPath(path);
+
+        if (!_store.load(records, _lastProfileId))
+            return;
+
+        foreach (const ProfileRecord& record, records) {
+            if (_profilesById.contains(record.id))
+                continue;
+
+            insert(new ServiceProfile(record));
+        }
+    }
 
     ServiceProfile* createProfile(NetworkService *service)
     {
-        ServiceProfile *profile = new ServiceProfile(service, _lastProfileId++);
-        _profiles.append(profile);
+        ServiceProfile *profile;
+
+        if (_profiles.size() >= PROFILE_LIST_MAX_SIZE)
+            pruneDetached();
+
+        profile = new ServiceProfile(service, _lastProfileId++);
+        insert(profile);
+        scheduleSave();
         return profile;
     }
 
-    ServiceProfile* findProfileById(int id)
+    ServiceProfile* findProfileById(int id) const
     {
-        ServiceProfile *profile = NULL;
+        return _profilesById.value(id, NULL);
+    }
 
-        foreach (ServiceProfile *currentProfile, _profiles) {
-            if (currentProfile->id() == id) {
-                profile = currentProfile;
-                break;
-            }
-        }
+    ServiceProfile* findProfileByDBusPath(const QString& path) const
+    {
+        return _profilesByPath.value(path, NULL);
+    }
+
+    /* Connects the profile of the service (if there is one) with it; returns the
+     * profile */
+    ServiceProfile* attachService(NetworkService *service)
+    {
+        ServiceProfile *profile = findProfileByDBusPath(service->dbusPath());
+
+        if (profile == NULL)
+            return NULL;
+
+        profile->setService(service);
+        if (profile->updateFromService())
+            scheduleSave();
 
         return profile;
     }
 
-    ServiceProfile* findProfileByDBusPath(const QString& path)
+    /* The service went out of range but we keep its profile */
+    ServiceProfile* detachService(const QString& path)
     {
-        ServiceProfile *profile = NULL;
+        ServiceProfile *profile = findProfileByDBusPath(path);
 
-        foreach (ServiceProfile *currentProfile, _profiles) {
-            if (currentProfile->dbusPath() == path) {
-                profile = currentProfile;
-                break;
-            }
-        }
+        if (profile != NULL)
+            profile->setService(NULL);
 
         return profile;
     }
 
     void removeProfileById(int id)
     {
-        ServiceProfile *profileToRemove = NULL;
-
-        foreach (ServiceProfile *currentProfile, _profiles) {
-            if (currentProfile->id() == id) {
-                profileToRemove = currentProfile;
-                break;
-            }
-        }
+        ServiceProfile *profileToRemove = _profilesById.take(id);
 
         if (profileToRemove != NULL) {
+            _profilesByPath.remove(profileToRemove->dbusPath());
             _profiles.removeOne(profileToRemove);
             delete profileToRemove;
+            scheduleSave();
         }
     }
 
-    const QList<ServiceProfile*> list()
+    /* Writes pending changes to the store right away */
+    void flush()
+    {
+        if (_saveTimeout == 0)
+            return;
+
+        g_source_remove(_saveTimeout);
+        _saveTimeout = 0;
+        save();
+    }
+
+    const QList<ServiceProfile*> list() const
     {
         return _profiles;
     }
@@ -118,6 +246,58 @@ public:
 private:
     int _lastProfileId;
     QList<ServiceProfile*> _profiles;
+    QHash<int, ServiceProfile*> _profilesById;
+    QHash<QString, ServiceProfile*> _profilesByPath;
+    ProfileStore _store;
+    guint _saveTimeout;
+
+    void insert(ServiceProfile *profile)
+    {
+        _profiles.append(profile);
+        _profilesById.insert(profile->id(), profile);
+        _profilesByPath.insert(profile->dbusPath(), profile);
+
+        if (profile->id() >= _lastProfileId)
+            _lastProfileId = profile->id() + 1;
+    }
+
+    /* Drops the oldest profile whose network is out of range. Connman still knows
+     * the network and we create a new profile once it's back in range. */
+    void pruneDetached()
+    {
+        foreach (ServiceProfile *profile, _profiles) {
+            if (profile->service() == NULL) {
+                removeProfileById(profile->id());
+                return;
+            }
+        }
+    }
+
+    void scheduleSave()
+    {
+        if (_saveTimeout == 0)
+            _saveTimeout = g_timeout_add(PROFILE_SAVE_DELAY, cbSave, this);
+    }
+
+    static gboolean cbSave(gpointer user_data)
+    {
+        ServiceProfileList *self = static_cast<ServiceProfileList*>(user_data);
+
+        self->_saveTimeout = 0;
+        self->save();
+
+        return FALSE;
+    }
+
+    void save()
+    {
+        QList<ProfileRecord> records;
+
+        foreach (ServiceProfile *profile, _profiles)
+            records.append(profile->record());
+
+        _store.save(records, _lastProfileId);
+    }
 };
 
 #endif
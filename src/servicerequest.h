@@ -27,7 +27,6 @@ public:
     LunaServiceRequestData()
         : handle(NULL),
           message(NULL),
-          response(NULL),
           valid(false)
     {
     }
@@ -40,13 +39,11 @@ public:
     {
         handle = NULL;
         message = NULL;
-        response = NULL;
         valid = false;
     }
 
     LSHandle *handle;
     LSMessage *message;
-    json_object *response;
     bool valid;
 };
 
@@ -0,0 +1,145 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#ifndef SERVICESTATEHISTORY_H_
+#define SERVICESTATEHISTORY_H_
+
+#include <glib.h>
+
+#include "utilities.h"
+
+#define SERVICE_STATE_HISTORY_SIZE  8
+
+/* The last SERVICE_STATE_HISTORY_SIZE state transitions of a service together with
+ * statistics about the attempts to join it. An attempt starts when the service
+ * enters association; it's successful once the service got ready. */
+class ServiceStateHistory
+{
+public:
+    ServiceStateHistory() :
+        _next(0),
+        _count(0),
+        _attemptStarted(0),
+        _attemptJoined(false),
+        _joinAttempts(0),
+        _joinSuccesses(0),
+        _onlineCount(0),
+        _timeToOnlineTotal(0)
+    {
+    }
+
+    ~ServiceStateHistory() { }
+
+    /* time is in microseconds of the monotonic clock */
+    void record(int state, gint64 time)
+    {
+        if (_count > 0 && state == this->state(0))
+            return;
+
+        _states[_next] = state;
+        _times[_next] = time;
+        _next = (_next + 1) % SERVICE_STATE_HISTORY_SIZE;
+        if (_count < SERVICE_STATE_HISTORY_SIZE)
+            _count++;
+
+        switch (state) {
+        case CONNMAN_SERVICE_STATE_ASSOCIATION:
+            if (_attemptStarted == 0) {
+                _attemptStarted = time;
+                _attemptJoined = false;
+                _joinAttempts++;
+            }
+            break;
+        case CONNMAN_SERVICE_STATE_READY:
+            if (_attemptStarted != 0 && !_attemptJoined) {
+                _attemptJoined = true;
+                _joinSuccesses++;
+            }
+            break;
+        case CONNMAN_SERVICE_STATE_ONLINE:
+            if (_attemptStarted != 0) {
+                if (!_attemptJoined)
+                    _joinSuccesses++;
+                _onlineCount++;
+                _timeToOnlineTotal += (time - _attemptStarted) / 1000;
+                _attemptStarted = 0;
+            }
+            break;
+        case CONNMAN_SERVICE_STATE_IDLE:
+        case CONNMAN_SERVICE_STATE_DISCONNECT:
+        case CONNMAN_SERVICE_STATE_FAILURE:
+            _attemptStarted = 0;
+            break;
+        }
+    }
+
+    unsigned int count() const
+    {
+        return _count;
+    }
+
+    /* n = 0 is the latest transition; states are CONNMAN_SERVICE_STATE_* */
+    int state(unsigned int n) const
+    {
+        return _states[(_next + SERVICE_STATE_HISTORY_SIZE - 1 - n) % SERVICE_STATE_HISTORY_SIZE];
+    }
+
+    gint64 time(unsigned int n) const
+    {
+        return _times[(_next + SERVICE_STATE_HISTORY_SIZE - 1 - n) % SERVICE_STATE_HISTORY_SIZE];
+    }
+
+    /* The state the service was in before its current one; 0 if we don't know */
+    int previousState() const
+    {
+        return _count > 1 ? state(1) : 0;
+    }
+
+    unsigned int joinAttempts() const
+    {
+        return _joinAttempts;
+    }
+
+    unsigned int joinSuccesses() const
+    {
+        return _joinSuccesses;
+    }
+
+    /* Average over all attempts which made it online in milliseconds */
+    unsigned int averageTimeToOnline() const
+    {
+        return _onlineCount > 0 ? _timeToOnlineTotal / _onlineCount : 0;
+    }
+
+private:
+    int _states[SERVICE_STATE_HISTORY_SIZE];
+    gint64 _times[SERVICE_STATE_HISTORY_SIZE];
+    unsigned int _next;
+    unsigned int _count;
+
+    gint64 _attemptStarted;
+    bool _attemptJoined;
+    unsigned int _joinAttempts;
+    unsigned int _joinSuccesses;
+    unsigned int _onlineCount;
+    guint64 _timeToOnlineTotal;
+};
+
+#endif
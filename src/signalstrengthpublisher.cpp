@@ -0,0 +1,175 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#include "signalstrengthpublisher.h"
+#include "utilities.h"
+
+/* Lowest strength value which still maps to the provided number of bars */
+static unsigned int lowest_strength_for_bars(unsigned int bars)
+{
+    return (bars * 100 + MAX_SIGNAL_BARS - 1) / MAX_SIGNAL_BARS;
+}
+
+SignalStrengthPublisher::SignalStrengthPublisher(QObject *parent) :
+    QObject(parent),
+    _policy(AdapterSettings::STRENGTH_POLICY_BAR_CHANGE),
+    _hysteresis(0),
+    _minInterval(0),
+    _trailingDelay(0),
+    _latestStrength(0),
+    _publishedStrength(0),
+    _publishedBars(0),
+    _lastPublishTime(0),
+    _trailingUpdateTimeout(0)
+{
+}
+
+SignalStrengthPublisher::~SignalStrengthPublisher()
+{
+    cancelTrailingUpdate();
+}
+
+void SignalStrengthPublisher::configure(AdapterSettings::StrengthPolicy policy, unsigned int hysteresis,
+                                        unsigned int minInterval, unsigned int trailingDelay)
+{
+    _policy = policy;
+    _hysteresis = hysteresis;
+    _minInterval = minInterval;
+    _trailingDelay = trailingDelay;
+}
+
+void SignalStrengthPublisher::reset(unsigned int strength)
+{
+    cancelTrailingUpdate();
+
+    _latestStrength = strength;
+    _publishedStrength = strength;
+    _publishedBars = convert_strength_to_signal_bars(strength);
+    _lastPublishTime = g_get_monotonic_time();
+}
+
+void SignalStrengthPublisher::update(unsigned int strength)
+{
+    _latestStrength = strength;
+
+    if (isSignificant(strength) && !isRateLimited()) {
+        post(strength, convert_strength_to_signal_bars(strength));
+        return;
+    }
+
+    /* Only changes we withheld are published later on; anything else (e.g. jitter
+     * within the current bar) isn't worth a post at all */
+    if (isWithheld(strength))
+        scheduleTrailingUpdate();
+    else
+        cancelTrailingUpdate();
+}
+
+bool SignalStrengthPublisher::isWithheld(unsigned int strength) const
+{
+    /* Rate limited */
+    if (isSignificant(strength))
+        return true;
+
+    /* A bar change within the hysteresis band */
+    return _policy == AdapterSettings::STRENGTH_POLICY_HYSTERESIS &&
+           convert_strength_to_signal_bars(strength) != _publishedBars;
+}
+
+bool SignalStrengthPublisher::isSignificant(unsigned int strength) const
+{
+    unsigned int bars = convert_strength_to_signal_bars(strength);
+    unsigned int threshold;
+
+    switch (_policy) {
+    case AdapterSettings::STRENGTH_POLICY_BAR_CHANGE:
+        return bars != _publishedBars;
+    case AdapterSettings::STRENGTH_POLICY_HYSTERESIS:
+        /* Only move to another bar once the strength is clearly beyond the border of
+         * the current one so we don't flap around a border */
+        if (bars > _publishedBars) {
+            threshold = MIN(lowest_strength_for_bars(_publishedBars + 1) + _hysteresis, 100);
+            return strength >= threshold;
+        }
+        else if (bars < _publishedBars) {
+            threshold = lowest_strength_for_bars(_publishedBars);
+            return strength + _hysteresis < threshold;
+        }
+        return false;
+    case AdapterSettings::STRENGTH_POLICY_MIN_INTERVAL:
+        return strength != _publishedStrength;
+    }
+
+    return true;
+}
+
+bool SignalStrengthPublisher::isRateLimited() const
+{
+    if (_policy != AdapterSettings::STRENGTH_POLICY_MIN_INTERVAL || _minInterval == 0)
+        return false;
+
+    return (g_get_monotonic_time() - _lastPublishTime) < (gint64) _minInterval * 1000;
+}
+
+void SignalStrengthPublisher::post(unsigned int strength, unsigned int signalBars)
+{
+    cancelTrailingUpdate();
+
+    _publishedStrength = strength;
+    _publishedBars = signalBars;
+    _lastPublishTime = g_get_monotonic_time();
+
+    emit publish(strength, signalBars);
+}
+
+void SignalStrengthPublisher::scheduleTrailingUpdate()
+{
+    unsigned int delay;
+
+    /* Don't push an already scheduled update further away as otherwise a constantly
+     * changing strength would never be published */
+    if (_trailingUpdateTimeout != 0)
+        return;
+
+    delay = _policy == AdapterSettings::STRENGTH_POLICY_MIN_INTERVAL ? _minInterval : _trailingDelay;
+
+    _trailingUpdateTimeout = g_timeout_add(delay, cbTrailingUpdate, this);
+}
+
+void SignalStrengthPublisher::cancelTrailingUpdate()
+{
+    if (_trailingUpdateTimeout != 0) {
+        g_source_remove(_trailingUpdateTimeout);
+        _trailingUpdateTimeout = 0;
+    }
+}
+
+gboolean SignalStrengthPublisher::cbTrailingUpdate(gpointer user_data)
+{
+    SignalStrengthPublisher *self = (SignalStrengthPublisher*) user_data;
+
+    self->_trailingUpdateTimeout = 0;
+
+    /* The strength settled on the other side of what we held back */
+    if (self->isWithheld(self->_latestStrength))
+        self->post(self->_latestStrength, convert_strength_to_signal_bars(self->_latestStrength));
+
+    return FALSE;
+}
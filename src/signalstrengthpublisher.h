@@ -0,0 +1,73 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#ifndef SIGNALSTRENGTHPUBLISHER_H_
+#define SIGNALSTRENGTHPUBLISHER_H_
+
+#include <QObject>
+#include <glib.h>
+
+#include "adaptersettings.h"
+
+/* Decides which of the strength updates connman sends us for the current service are
+ * worth to be published to our subscribers. Updates held back are not lost: once
+ * things calm down the latest value is published as trailing update. */
+class SignalStrengthPublisher : public QObject
+{
+    Q_OBJECT
+
+public:
+    SignalStrengthPublisher(QObject *parent = 0);
+    virtual ~SignalStrengthPublisher();
+
+    void configure(AdapterSettings::StrengthPolicy policy, unsigned int hysteresis,
+                   unsigned int minInterval, unsigned int trailingDelay);
+
+    /* Sets the value subscribers already know about (e.g. as part of the connection
+     * status) without publishing it */
+    void reset(unsigned int strength);
+    void update(unsigned int strength);
+
+signals:
+    void publish(unsigned int strength, unsigned int signalBars);
+
+private:
+    AdapterSettings::StrengthPolicy _policy;
+    unsigned int _hysteresis;
+    unsigned int _minInterval;
+    unsigned int _trailingDelay;
+
+    unsigned int _latestStrength;
+    unsigned int _publishedStrength;
+    unsigned int _publishedBars;
+    gint64 _lastPublishTime;
+    guint _trailingUpdateTimeout;
+
+    bool isSignificant(unsigned int strength) const;
+    bool isRateLimited() const;
+    bool isWithheld(unsigned int strength) const;
+    void post(unsigned int strength, unsigned int signalBars);
+    void scheduleTrailingUpdate();
+    void cancelTrailingUpdate();
+
+    static gboolean cbTrailingUpdate(gpointer user_data);
+};
+
+#endif
@@ -0,0 +1,42 @@
+# Everything but the entry point and the luna service setup in main.cpp and
+# servicemgr.cpp, shared by the adapter and bench/adapterbench
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/wifiservice.cpp \
+    $$PWD/connmanagent.cpp \
+    $$PWD/utilities.cpp \
+    $$PWD/adaptersettings.cpp \
+    $$PWD/signalstrengthpublisher.cpp \
+    $$PWD/jsonwriter.cpp \
+    $$PWD/requestparser.cpp \
+    $$PWD/connectrequestqueue.cpp \
+    $$PWD/connecttimings.cpp \
+    $$PWD/adaptermetrics.cpp \
+    $$PWD/tracering.cpp \
+    $$PWD/profilestore.cpp \
+    $$PWD/statussubscriptions.cpp \
+    $$PWD/connmanservicetable.cpp
+
+HEADERS += \
+    $$PWD/wifiservice.h \
+    $$PWD/connmanagent.h \
+    $$PWD/serviceprofile.h \
+    $$PWD/scanresultcache.h \
+    $$PWD/wifiservicelist.h \
+    $$PWD/utilities.h \
+    $$PWD/adaptersettings.h \
+    $$PWD/signalstrengthpublisher.h \
+    $$PWD/jsonwriter.h \
+    $$PWD/requestparser.h \
+    $$PWD/connectrequestqueue.h \
+    $$PWD/connecttimings.h \
+    $$PWD/latencyhistogram.h \
+    $$PWD/adaptermetrics.h \
+    $$PWD/tracering.h \
+    $$PWD/profilestore.h \
+    $$PWD/statussubscriptions.h \
+    $$PWD/connmanservicetable.h \
+    $$PWD/servicestatehistory.h \
+    $$PWD/networklistoptions.h
@@ -0,0 +1,181 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#include <stdlib.h>
+
+#include "statussubscriptions.h"
+#include "requestparser.h"
+
+enum { FILTER_EVENTS, FILTER_MIN_SIGNAL_BAR_DELTA };
+static const RequestParser::Field _filterFields[] = {
+    { "events", RequestParser::FIELD_STRING_ARRAY },
+    { "minSignalBarDelta", RequestParser::FIELD_INT },
+};
+
+StatusSubscriptions::StatusSubscriptions() :
+    _count(0)
+{
+}
+
+StatusSubscriptions::~StatusSubscriptions()
+{
+}
+
+bool StatusSubscriptions::parseFilter(const char *payload, Filter& filter, QString& errorText)
+{
+    RequestParser request(_filterFields, FIELD_COUNT(_filterFields));
+
+    filter.events = STATUS_EVENT_ALL;
+    filter.minSignalBarDelta = 0;
+
+    if (!request.parse(payload)) {
+        errorText = request.errorText();
+        return false;
+    }
+
+    if (request.has(FILTER_EVENTS)) {
+        filter.events = 0;
+
+        foreach (const QString& event, request.stringListValue(FILTER_EVENTS)) {
+            if (event == "connectionState")
+                filter.events |= STATUS_EVENT_CONNECTION_STATE;
+            else if (event == "signalStrength")
+                filter.events |= STATUS_EVENT_SIGNAL_STRENGTH;
+            else if (event == "serviceState")
+                filter.events |= STATUS_EVENT_SERVICE_STATE;
+            else {
+                errorText = "Invalid value for parameter events";
+                return false;
+            }
+        }
+    }
+
+    if (request.has(FILTER_MIN_SIGNAL_BAR_DELTA)) {
+        if (request.intValue(FILTER_MIN_SIGNAL_BAR_DELTA) < 0) {
+            errorText = "Invalid value for parameter minSignalBarDelta";
+            return false;
+        }
+
+        filter.minSignalBarDelta = request.intValue(FILTER_MIN_SIGNAL_BAR_DELTA);
+    }
+
+    /* Keeps subscribers which don't get strength posts at all in one group */
+    if (!(filter.events & STATUS_EVENT_SIGNAL_STRENGTH))
+        filter.minSignalBarDelta = 0;
+
+    return true;
+}
+
+int StatusSubscriptions::findGroup(const Filter& filter) const
+{
+    int n;
+
+    for (n = 0; n < _groups.size(); n++) {
+        if (_groups[n].filter.events == filter.events &&
+            _groups[n].filter.minSignalBarDelta == filter.minSignalBarDelta)
+            return n;
+    }
+
+    return -1;
+}
+
+QByteArray StatusSubscriptions::add(const Filter& filter, unsigned int signalBars,
+                                    bool& baselineMoved)
+{
+    int index = findGroup(filter);
+    Group group;
+
+    _count++;
+    baselineMoved = false;
+
+    if (index >= 0) {
+        _groups[index].subscribers++;
+
+        /* The new subscriber starts from the current bars; the others have to be told
+         * about them too or the group would measure the delta from two baselines */
+        if (filter.minSignalBarDelta > 0 && _groups[index].lastSignalBars != signalBars) {
+            _groups[index].lastSignalBars = signalBars;
+            baselineMoved = true;
+        }
+
+        return _groups[index].key;
+    }
+
+    group.filter = filter;
+    group.subscribers = 1;
+    group.lastSignalBars = signalBars;
+
+    if (filter.events == STATUS_EVENT_ALL && filter.minSignalBarDelta == 0) {
+        group.key = STATUS_SUBSCRIPTION_KEY;
+    }
+    else {
+        group.key = STATUS_SUBSCRIPTION_KEY "/";
+        group.key.append(QByteArray::number(filter.events));
+        group.key.append('/');
+        group.key.append(QByteArray::number(filter.minSignalBarDelta));
+    }
+
+    _groups.append(group);
+
+    return group.key;
+}
+
+void StatusSubscriptions::remove(const Filter& filter)
+{
+    int index = findGroup(filter);
+
+    if (index < 0)
+        return;
+
+    _count--;
+
+    if (--_groups[index].subscribers == 0)
+        _groups.removeAt(index);
+}
+
+bool StatusSubscriptions::wants(unsigned int event) const
+{
+    foreach (const Group& group, _groups) {
+        if (group.filter.events & event)
+            return true;
+    }
+
+    return false;
+}
+
+void StatusSubscriptions::keysFor(unsigned int event, unsigned int signalBars, QList<QByteArray>& keys)
+{
+    QList<Group>::iterator group;
+
+    for (group = _groups.begin(); group != _groups.end(); ++group) {
+        if (!(group->filter.events & event))
+            continue;
+
+        if (event == STATUS_EVENT_SIGNAL_STRENGTH && group->filter.minSignalBarDelta > 0) {
+            if ((unsigned int) abs((int) signalBars - (int) group->lastSignalBars) <
+                group->filter.minSignalBarDelta)
+                continue;
+
+            group->lastSignalBars = signalBars;
+        }
+
+        keys.append(group->key);
+    }
+}
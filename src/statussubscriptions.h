@@ -0,0 +1,85 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#ifndef STATUSSUBSCRIPTIONS_H_
+#define STATUSSUBSCRIPTIONS_H_
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+/* Kinds of posts getstatus subscribers can ask for */
+#define STATUS_EVENT_CONNECTION_STATE   (1 << 0)
+#define STATUS_EVENT_SIGNAL_STRENGTH    (1 << 1)
+#define STATUS_EVENT_SERVICE_STATE      (1 << 2)
+#define STATUS_EVENT_ALL                (STATUS_EVENT_CONNECTION_STATE | \
+                                         STATUS_EVENT_SIGNAL_STRENGTH | \
+                                         STATUS_EVENT_SERVICE_STATE)
+
+#define STATUS_SUBSCRIPTION_KEY         "getstatus"
+
+/* getstatus subscribers grouped by the filter they subscribed with. All subscribers
+ * of a group share one subscription key so a post is handed to luna once per group
+ * which wants it instead of once per subscriber. Subscribers without a filter get
+ * everything under the plain method name as key. */
+class StatusSubscriptions
+{
+public:
+    struct Filter {
+        unsigned int events;
+        /* only post strength changes which move the bars at least this much */
+        unsigned int minSignalBarDelta;
+    };
+
+    StatusSubscriptions();
+    ~StatusSubscriptions();
+
+    /* Reads the filter from a subscription request; returns false with errorText set
+     * if it's invalid */
+    static bool parseFilter(const char *payload, Filter& filter, QString& errorText);
+
+    /* Returns the key to add the subscriber with. Sets baselineMoved when the group
+     * it joins now measures the bar delta from signalBars; the subscribers already in
+     * it need a post with the current bars then. */
+    QByteArray add(const Filter& filter, unsigned int signalBars, bool& baselineMoved);
+    void remove(const Filter& filter);
+
+    unsigned int count() const { return _count; }
+    bool wants(unsigned int event) const;
+
+    /* Keys of the groups the post for the event has to go to. Groups with a minimum
+     * bar delta remember the bars they were told about last. */
+    void keysFor(unsigned int event, unsigned int signalBars, QList<QByteArray>& keys);
+
+private:
+    struct Group {
+        Filter filter;
+        QByteArray key;
+        unsigned int subscribers;
+        unsigned int lastSignalBars;
+    };
+
+    QList<Group> _groups;
+    unsigned int _count;
+
+    int findGroup(const Filter& filter) const;
+};
+
+#endif
@@ -0,0 +1,86 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#include <unistd.h>
+
+#include "tracering.h"
+
+TraceRing::TraceRing() :
+    _next(0)
+{
+    guint n;
+
+    for (n = 0; n < TRACE_RING_SIZE; n++)
+        _events[n].name = NULL;
+}
+
+TraceRing::~TraceRing()
+{
+}
+
+void TraceRing::record(Phase phase, const char *name, int value)
+{
+    guint slot = ((guint) g_atomic_int_add(&_next, 1)) & (TRACE_RING_SIZE - 1);
+    Event *event = &_events[slot];
+
+    event->timestamp = g_get_monotonic_time();
+    event->name = name;
+    event->value = value;
+    event->phase = phase;
+}
+
+void TraceRing::appendToMessage(JsonWriter& message) const
+{
+    guint next = (guint) g_atomic_int_get(&_next);
+    guint n;
+    int pid = getpid();
+    char phase[2] = { 0, 0 };
+
+    message.member("displayTimeUnit", "ms");
+    message.key("traceEvents").beginArray();
+
+    /* Slots which were never written are skipped; this way the counter can wrap */
+    for (n = next - TRACE_RING_SIZE; n != next; n++) {
+        const Event& event = _events[n & (TRACE_RING_SIZE - 1)];
+
+        if (event.name == NULL)
+            continue;
+
+        phase[0] = event.phase;
+
+        message.beginObject();
+        message.member("name", event.name);
+        message.member("ph", phase);
+        message.key("ts").raw(QByteArray::number((qlonglong) event.timestamp));
+        message.member("pid", pid);
+        message.member("tid", pid);
+
+        /* Instant events are shown for the whole process rather than a thread */
+        if (event.phase == PHASE_INSTANT)
+            message.member("s", "p");
+
+        if (event.value >= 0)
+            message.key("args").beginObject().member("value", event.value).endObject();
+
+        message.endObject();
+    }
+
+    message.endArray();
+}
@@ -0,0 +1,69 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#ifndef TRACERING_H_
+#define TRACERING_H_
+
+#include <glib.h>
+
+#include "jsonwriter.h"
+
+/* Has to be a power of two */
+#define TRACE_RING_SIZE     4096
+
+/* Fixed size ring of the latest events of the adapter which is cheap enough to stay
+ * enabled all the time: recording an event only claims the next slot and fills in
+ * a few words. Event names have to be string literals as only the pointer is kept.
+ * The content can be exported in the Chrome trace event format. */
+class TraceRing
+{
+public:
+    enum Phase {
+        PHASE_BEGIN = 'B',
+        PHASE_END = 'E',
+        PHASE_INSTANT = 'i'
+    };
+
+    TraceRing();
+    ~TraceRing();
+
+    void record(Phase phase, const char *name, int value = -1);
+
+    void begin(const char *name) { record(PHASE_BEGIN, name); }
+    void end(const char *name) { record(PHASE_END, name); }
+    void instant(const char *name, int value = -1) { record(PHASE_INSTANT, name, value); }
+
+    /* Appends the members of a trace object with the recorded events from the oldest
+     * to the latest to the currently open object */
+    void appendToMessage(JsonWriter& message) const;
+
+private:
+    struct Event {
+        gint64 timestamp;
+        const char *name;
+        int value;
+        char phase;
+    };
+
+    Event _events[TRACE_RING_SIZE];
+    volatile gint _next;
+};
+
+#endif
@@ -18,68 +18,142 @@
  * LICENSE@@@
  */
 
-#include <string.h>
 #include "utilities.h"
 
-int parse_connman_service_state(const char* state)
+struct connman_name {
+    const char *name;
+    int value;
+};
+
+/* All service state names have a different length which makes the length a perfect
+ * hash for them; a single compare tells whether it's really the name we found */
+static const connman_name service_states_by_length[] = {
+    { NULL, 0 },
+    { NULL, 0 },
+    { NULL, 0 },
+    { NULL, 0 },
+    { "idle", CONNMAN_SERVICE_STATE_IDLE },
+    { "ready", CONNMAN_SERVICE_STATE_READY },
+    { "online", CONNMAN_SERVICE_STATE_ONLINE },
+    { "failure", CONNMAN_SERVICE_STATE_FAILURE },
+    { NULL, 0 },
+    { NULL, 0 },
+    { "disconnect", CONNMAN_SERVICE_STATE_DISCONNECT },
+    { "association", CONNMAN_SERVICE_STATE_ASSOCIATION },
+    { NULL, 0 },
+    { "configuration", CONNMAN_SERVICE_STATE_CONFIGURATION }
+};
+
+/* The two lowest bits of the first character differ for all security names:
+ * 'p'sk = 0, 'i'eee8021x = 1, 'n'one = 2, 'w'ep = 3 */
+static const connman_name security_types_by_first_char[] = {
+    { "psk", CONNMAN_SECURITY_PSK },
+    { "ieee8021x", CONNMAN_SECURITY_IEEE8021X },
+    { "none", CONNMAN_SECURITY_NONE },
+    { "wep", CONNMAN_SECURITY_WEP }
+};
+
+#define N_ELEMENTS(array) ((int) (sizeof(array) / sizeof(array[0])))
+
+/* Indexed by CONNMAN_SERVICE_STATE_* */
+static const char* const service_state_names[] = {
+    "unknown",
+    "idle",
+    "association",
+    "configuration",
+    "ready",
+    "online",
+    "disconnect",
+    "failure"
+};
+
+/* Indexed by CONNMAN_SERVICE_STATE_*; failures depend on the state before and are
+ * handled separately */
+static const char* const palm_service_states[] = {
+    "notAssociated",
+    "notAssociated",    /* idle */
+    "associating",      /* association */
+    "associated",       /* configuration */
+    "ipConfigured",     /* ready */
+    "ipConfigured",     /* online */
+    "notAssociated",    /* disconnect */
+    "notAssociated"     /* failure */
+};
+
+/* Indexed by CONNMAN_SECURITY_* */
+static const char* const palm_security_types[] = {
+    NULL,               /* none */
+    "wep",
+    "wpa-personal",     /* psk */
+    "enterprise",       /* ieee8021x */
+    NULL                /* unknown */
+};
+
+int parse_connman_service_state(const QString& state)
 {
-    int result = CONNMAN_SERVICE_STATE_IDLE;
-
-    if (!strcmp(state, "idle"))
-        result = CONNMAN_SERVICE_STATE_IDLE;
-    else if (!strcmp(state, "association"))
-        result = CONNMAN_SERVICE_STATE_ASSOCIATION;
-    else if (!strcmp(state, "configuration"))
-        result = CONNMAN_SERVICE_STATE_CONFIGURATION;
-    else if (!strcmp(state, "ready"))
-        result = CONNMAN_SERVICE_STATE_READY;
-    else if (!strcmp(state, "online"))
-        result = CONNMAN_SERVICE_STATE_ONLINE;
-    else if (!strcmp(state, "disconnect"))
-        result = CONNMAN_SERVICE_STATE_DISCONNECT;
-    else if (!strcmp(state, "failure"))
-        result = CONNMAN_SERVICE_STATE_FAILURE;
-
-    return result;
+    int length = state.length();
+
+    if (length >= N_ELEMENTS(service_states_by_length) ||
+        service_states_by_length[length].name == NULL ||
+        state != QLatin1String(service_states_by_length[length].name))
+        return CONNMAN_SERVICE_STATE_IDLE;
+
+    return service_states_by_length[length].value;
 }
 
-char* convert_connman_security_type_to_palm(const char* type)
+int parse_connman_security_type(const QString& type)
 {
-    if (!strcmp(type, "psk"))
-        return "wpa-personal";
-    else if (!strcmp(type, "ieee8021x"))
-        return "enterprise";
-    else if (!strcmp(type, "wep"))
-        return "wep";
-
-    return NULL;
+    const connman_name *entry;
+
+    if (type.isEmpty())
+        return CONNMAN_SECURITY_UNKNOWN;
+
+    entry = &security_types_by_first_char[type.at(0).unicode() & 3];
+    if (type != QLatin1String(entry->name))
+        return CONNMAN_SECURITY_UNKNOWN;
+
+    return entry->value;
 }
 
-char* convert_connman_service_state_to_palm(int state, int last_state)
+const char* convert_connman_service_state_to_name(int state)
 {
-    switch (state) {
-    case CONNMAN_SERVICE_STATE_DISCONNECT:
-    case CONNMAN_SERVICE_STATE_IDLE:
-        return "notAssociated";
-    case CONNMAN_SERVICE_STATE_ASSOCIATION:
-        return "associating";
-    case CONNMAN_SERVICE_STATE_CONFIGURATION:
-        return "associated";
-    case CONNMAN_SERVICE_STATE_READY:
-    case CONNMAN_SERVICE_STATE_ONLINE:
-        return "ipConfigured";
-    case CONNMAN_SERVICE_STATE_FAILURE:
+    if (state < 0 || state >= N_ELEMENTS(service_state_names))
+        return service_state_names[0];
+
+    return service_state_names[state];
+}
+
+const char* convert_connman_security_to_palm(int security)
+{
+    if (security < 0 || security >= N_ELEMENTS(palm_security_types))
+        return NULL;
+
+    return palm_security_types[security];
+}
+
+const char* convert_connman_service_state_to_palm(int state, int last_state)
+{
+    if (state == CONNMAN_SERVICE_STATE_FAILURE) {
         if (last_state == CONNMAN_SERVICE_STATE_ASSOCIATION)
             return "associationFailed";
         else if (last_state == CONNMAN_SERVICE_STATE_CONFIGURATION)
             return "ipFailed";
-        break;
     }
 
-    return "notAssociated";
+    if (state < 0 || state >= N_ELEMENTS(palm_service_states))
+        return "notAssociated";
+
+    return palm_service_states[state];
 }
 
-char* convert_connman_service_state_to_palm(int state)
+const char* convert_connman_service_state_to_palm(int state)
 {
     return convert_connman_service_state_to_palm(state, state);
 }
+
+/* We only get a normalized value for the signal strength in range of 0-100 from
+ * connman so we have to convert it here to map it to com.palm.wifi API */
+unsigned int convert_strength_to_signal_bars(unsigned int strength)
+{
+    return (strength * MAX_SIGNAL_BARS) / 100;
+}
@@ -21,6 +21,8 @@
 #ifndef UTILITIES_H_
 #define UTILITIES_H_
 
+#include <QString>
+
 #define CONNMAN_SERVICE_STATE_IDLE              1
 #define CONNMAN_SERVICE_STATE_ASSOCIATION       2
 #define CONNMAN_SERVICE_STATE_CONFIGURATION     3
@@ -29,9 +31,23 @@
 #define CONNMAN_SERVICE_STATE_DISCONNECT        6
 #define CONNMAN_SERVICE_STATE_FAILURE           7
 
-int parse_connman_service_state(const char* state);
-char* convert_connman_security_type_to_palm(const char* type);
-char* convert_connman_service_state_to_palm(int state, int last_state);
-char* convert_connman_service_state_to_palm(int state);
+#define CONNMAN_SECURITY_NONE                   0
+#define CONNMAN_SECURITY_WEP                    1
+#define CONNMAN_SECURITY_PSK                    2
+#define CONNMAN_SECURITY_IEEE8021X              3
+#define CONNMAN_SECURITY_UNKNOWN                4
+
+#define MAX_SIGNAL_BARS         3
+
+/* Decode connman's state and security names into CONNMAN_SERVICE_STATE_* and
+ * CONNMAN_SECURITY_* */
+int parse_connman_service_state(const QString& state);
+int parse_connman_security_type(const QString& type);
+const char* convert_connman_service_state_to_name(int state);
+
+const char* convert_connman_security_to_palm(int security);
+const char* convert_connman_service_state_to_palm(int state, int last_state);
+const char* convert_connman_service_state_to_palm(int state);
+unsigned int convert_strength_to_signal_bars(unsigned int strength);
 
 #endif
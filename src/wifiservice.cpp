@@ -23,16 +23,25 @@
  * LICENSE@@@
  */
 
-#include <cjson/json.h>
+#include <signal.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include <glib-unix.h>
+#include <glib/gstdio.h>
+
+#include <QCoreApplication>
 
 #include "wifiservice.h"
 #include "connmanagent.h"
 #include "utilities.h"
+#include "adaptersettings.h"
+#include "jsonwriter.h"
+#include "requestparser.h"
 
 #define WIFI_TECHNOLOGY_NAME    "wifi"
 #define AGENT_PATH              "/WifiSettings"
-
-#define MAX_SIGNAL_BARS         3
+#define TRACE_FILE_NAME         "connman-adapter-trace.json"
 
 static LSMethod _serviceMethods[]  = {
     { "getstatus", WifiNetworkService::cbGetStatus },
@@ -43,16 +52,99 @@ static LSMethod _serviceMethods[]  = {
     { "getinfo", WifiNetworkService::cbGetInfo },
     { "deleteprofile", WifiNetworkService::cbDeleteProfile },
     { "getprofilelist", WifiNetworkService::cbGetProfileList },
+    { "getmetrics", WifiNetworkService::cbGetMetrics },
+    { "dumptrace", WifiNetworkService::cbDumpTrace },
+    { "getdiagnostics", WifiNetworkService::cbGetDiagnostics },
     { 0, 0 }
 };
 
+/* Fields we're looking for in the requests of the different methods; the enums are
+ * the indexes into the corresponding table */
+enum { SETSTATE_STATE };
+static const RequestParser::Field _setStateFields[] = {
+    { "state", RequestParser::FIELD_STRING },
+};
+
+enum {
+    FINDNETWORKS_MAX_AGE,
+    FINDNETWORKS_SORT_BY,
+    FINDNETWORKS_LIMIT,
+    FINDNETWORKS_OFFSET,
+    FINDNETWORKS_MIN_SIGNAL_LEVEL
+};
+static const RequestParser::Field _findNetworksFields[] = {
+    { "maxAge", RequestParser::FIELD_INT },
+    { "sortBy", RequestParser::FIELD_STRING },
+    { "limit", RequestParser::FIELD_INT },
+    { "offset", RequestParser::FIELD_INT },
+    { "minSignalLevel", RequestParser::FIELD_INT },
+};
+
+enum {
+    CONNECT_PROFILE_ID,
+    CONNECT_SSID,
+    CONNECT_WAS_CREATED_WITH_JOIN_OTHER,
+    CONNECT_SECURITY,
+    CONNECT_SECURITY_TYPE,
+    CONNECT_SIMPLE_SECURITY,
+    CONNECT_PASSKEY,
+    CONNECT_KEY_INDEX
+};
+static const RequestParser::Field _connectFields[] = {
+    { "profileId", RequestParser::FIELD_INT },
+    { "ssid", RequestParser::FIELD_STRING },
+    { "wasCreatedWithJoinOther", RequestParser::FIELD_BOOL },
+    { "security", RequestParser::FIELD_OBJECT },
+    { "security.securityType", RequestParser::FIELD_STRING },
+    { "security.simpleSecurity", RequestParser::FIELD_OBJECT },
+    { "security.simpleSecurity.passKey", RequestParser::FIELD_STRING },
+    { "security.simpleSecurity.keyIndex", RequestParser::FIELD_INT },
+};
+
+enum { PROFILE_PROFILE_ID };
+static const RequestParser::Field _profileFields[] = {
+    { "profileId", RequestParser::FIELD_INT },
+};
+
 WifiNetworkService::WifiNetworkService(QObject *parent) :
     QObject(parent),
     _manager(NULL),
     _wifiTechnology(NULL),
     _currentService(NULL),
-    _agent(this)
+    _agent(this),
+    _scanInProgress(false),
+    _scanRetry(0),
+    _networkSubscribers(0),
+    _networkChangesIdle(0),
+    _statusVersion(1),
+    _statusSnapshotVersion(0),
+    _connectionStatusSnapshotVersion(0),
+    _coalesceWindow(0),
+    _coalesceTimeout(0),
+    _pendingStrength(false),
+    _pendingStrengthValue(0),
+    _pendingSignalBars(0),
+    _startupFinished(false),
+    _startupBegan(g_get_monotonic_time()),
+    _startupTimeout(0),
+    _lastActivity(g_get_monotonic_time()),
+    _idleCheck(0)
 {
+    AdapterSettings *settings = AdapterSettings::instance();
+
+    _strengthPublisher.configure(settings->strengthPolicy, settings->strengthHysteresis,
+                                 settings->strengthMinInterval, settings->strengthTrailingDelay);
+    connect(&_strengthPublisher, SIGNAL(publish(uint, uint)), this, SLOT(publishStrength(uint, uint)));
+
+    _connectRequests.setTimeout(settings->connectTimeout);
+    _connectRequests.setTimeoutHandler(cbConnectTimeout, this);
+
+    _coalesceWindow = settings->coalesceWindow;
+
+    /* Known networks are there right away; their services are attached once connman
+     * reports them */
+    _profiles.load(settings->profileStorePath);
+
     _manager = NetworkManagerFactory::createInstance();
 
     connect(_manager, SIGNAL(availabilityChanged(bool)),
@@ -64,12 +156,142 @@ WifiNetworkService::WifiNetworkService(QObject *parent) :
     _wifiTechnology = _manager->getTechnology(WIFI_TECHNOLOGY_NAME);
     if (_wifiTechnology) {
         connect(_wifiTechnology, SIGNAL(poweredChanged(bool)),
-                this, SIGNAL(wifiPoweredChanged(bool)));
+                this, SLOT(wifiPoweredChanged(bool)));
         connect(_wifiTechnology, SIGNAL(connectedChanged(const bool&)), this, SLOT(wifiConnectedChanged(const bool&)));
     }
 
     QDBusConnection::systemBus().registerObject(AGENT_PATH, this);
     _manager->registerAgent(QString(AGENT_PATH));
+
+    /* The manager might know about some services already */
+    servicesChanged();
+
+    if (settings->onDemand) {
+        loadStoredStatus();
+        _idleCheck = g_timeout_add(settings->idleTimeout, cbIdleCheck, this);
+    }
+
+    /* Connman-qt fetches connman's state asynchronously; requests are held back until
+     * it's there so early callers don't see wifi as disconnected */
+    if (settings->startupTimeout > 0)
+        _startupTimeout = g_timeout_add(settings->startupTimeout, cbStartupTimeout, this);
+    else
+        finishStartup();
+}
+
+gboolean WifiNetworkService::cbStartupTimeout(gpointer user_data)
+{
+    WifiNetworkService *self = (WifiNetworkService*) user_data;
+
+    qWarning() << "Connman didn't report its services in time; serving requests anyway";
+
+    self->_startupTimeout = 0;
+    self->finishStartup();
+
+    return FALSE;
+}
+
+void WifiNetworkService::loadStoredStatus()
+{
+    QByteArray path = AdapterSettings::instance()->statusFilePath.toUtf8();
+    gchar *contents = NULL;
+    gsize length = 0;
+
+    if (!g_file_get_contents(path.constData(), &contents, &length, NULL))
+        return;
+
+    /* It's only valid for the very first requests after we were started */
+    g_unlink(path.constData());
+
+    if (length > 0 && contents[0] == '{')
+        _storedStatus = QByteArray(contents, length);
+
+    g_free(contents);
+}
+
+void WifiNetworkService::storeStatus()
+{
+    QByteArray path = AdapterSettings::instance()->statusFilePath.toUtf8();
+    GError *error = NULL;
+    gchar *directory;
+
+    if (!_manager->isAvailable())
+        return;
+
+    const QByteArray& status = statusSnapshot();
+
+    directory = g_path_get_dirname(path.constData());
+    g_mkdir_with_parents(directory, 0700);
+    g_free(directory);
+
+    if (!g_file_set_contents(path.constData(), status.constData(), status.length(), &error)) {
+        g_warning("Failed to store status in %s: %s", path.constData(), error->message);
+        g_error_free(error);
+    }
+}
+
+bool WifiNetworkService::isIdle()
+{
+    gint64 idleTime = g_get_monotonic_time() - _lastActivity;
+
+    if (!_startupFinished || idleTime < (gint64) AdapterSettings::instance()->idleTimeout * 1000)
+        return false;
+
+    if (!_connectRequests.isEmpty() || _scanInProgress || !_scanRequests.isEmpty())
+        return false;
+
+    if (_coalesceTimeout != 0)
+        return false;
+
+    return _statusSubscriptions.count() == 0 && _networkSubscribers == 0;
+}
+
+gboolean WifiNetworkService::cbIdleCheck(gpointer user_data)
+{
+    WifiNetworkService *self = (WifiNetworkService*) user_data;
+
+    if (!self->isIdle())
+        return TRUE;
+
+    qDebug() << "Nothing to do for us anymore; exiting until we're needed again";
+
+    self->storeStatus();
+    self->_idleCheck = 0;
+
+    QCoreApplication::quit();
+
+    return FALSE;
+}
+
+void WifiNetworkService::finishStartup()
+{
+    QList<DeferredRequest> deferredRequests;
+
+    if (_startupTimeout != 0) {
+        g_source_remove(_startupTimeout);
+        _startupTimeout = 0;
+    }
+
+    _startupFinished = true;
+    _storedStatus.clear();
+    _metrics.setStartupDuration((g_get_monotonic_time() - _startupBegan) / 1000);
+    _trace.instant("startupFinished", _deferredRequests.size());
+
+    /* Connman won't tell us about a connection which was up before we started */
+    if (_currentService == NULL) {
+        foreach (NetworkService *service, listNetworks()) {
+            if (serviceState(service) == READY || serviceState(service) == ONLINE) {
+                assignCurrentService(service);
+                break;
+            }
+        }
+    }
+
+    deferredRequests = _deferredRequests;
+    _deferredRequests.clear();
+
+    foreach (const DeferredRequest& request, deferredRequests)
+        dispatchRequest(request.name, request.handler, request.handle, request.message);
 }
 
 WifiNetworkService::~WifiNetworkService()
@@ -92,12 +314,52 @@ void WifiNetworkService::start(LSPalmService *service)
         return;
     }
 
+    if (!LSSubscriptionSetCancelFunction(_privateService, cbSubscriptionCanceled, this, &lserror)) {
+        LSErrorPrint(&lserror, stderr);
+        LSErrorFree(&lserror);
+    }
+
+    /* Lets the trace be written to a file even when the bus isn't responsive */
+    g_unix_signal_add(SIGUSR1, cbTraceSignal, this);
+
     LSErrorFree(&lserror);
 }
 
+gboolean WifiNetworkService::cbTraceSignal(gpointer user_data)
+{
+    WifiNetworkService *self = (WifiNetworkService*) user_data;
+    GError *error = NULL;
+    gchar *path;
+
+    path = g_build_filename(g_get_tmp_dir(), TRACE_FILE_NAME, NULL);
+
+    JsonWriter& trace = self->beginResponse();
+
+    trace.beginObject();
+    self->_trace.appendToMessage(trace);
+    trace.endObject();
+
+    if (!g_file_set_contents(path, trace.data(), trace.length(), &error)) {
+        g_warning("Failed to write trace to %s: %s", path, error->message);
+        g_error_free(error);
+    }
+    else {
+        g_message("Trace written to %s", path);
+    }
+
+    g_free(path);
+
+    return TRUE;
+}
+
 void WifiNetworkService::updateTechnologies(const QMap<QString, NetworkTechnology*> &added, const QStringList &removed)
 {
     QString wifiTechType = QString(WIFI_TECHNOLOGY_NAME);
+
+    _metrics.countSignal(AdapterMetrics::SIGNAL_TECHNOLOGIES_CHANGED);
+
+    markStatusChanged();
+
     if (added.contains(wifiTechType)) {
         _wifiTechnology = added.value(wifiTechType);
         connect(_wifiTechnology, SIGNAL(poweredChanged(bool)),
@@ -105,49 +367,102 @@ void WifiNetworkService::updateTechnologies(const QMap<QString, NetworkTechnolog
         connect(_wifiTechnology, SIGNAL(connectedChanged(const bool&)), this, SLOT(wifiConnectedChanged(const bool&)));
     }
     else if (removed.contains(wifiTechType)) {
+        /* Neither scans nor connects can finish without the technology */
+        cancelPendingScans();
+        cancelConnectRequests();
+
         _wifiTechnology = NULL; // FIXME: is it needed?
     }
 }
 
 void WifiNetworkService::servicesChanged()
 {
-    QList<NetworkService*> availableServices = listNetworks();
-    QList<ServiceProfile*> profilesToRemove;
+    const QString wifiTypeName(WIFI_TECHNOLOGY_NAME);
+    QList<NetworkService*> networks;
+    QSet<QString> addedPaths;
+    QSet<QString> removedPaths;
 
-    /* When the list of available services changes we have to adjust our list of available
-     * profiles */
-    foreach (ServiceProfile *profile, _profiles.list()) {
-        NetworkService* foundService = NULL;
+    _metrics.countSignal(AdapterMetrics::SIGNAL_SERVICES_CHANGED);
+    _trace.instant("servicesChanged");
 
-        foreach (NetworkService *service, availableServices) {
-            if (service->dbusPath() == profile->dbusPath()) {
-                foundService = service;
-                break;
-            }
-        }
+    foreach(NetworkService *network, _manager->getServices()) {
+        if (network->type() == wifiTypeName)
+            networks.append(network);
+    }
 
-        if (foundService == NULL) {
-            profilesToRemove.append(profile);
-        }
+    /* Only the services which appeared or disappeared since the last time we were called
+     * need any further processing */
+    _wifiServices.update(networks, &addedPaths, &removedPaths);
+
+    /* Subscribers are told we lost our service while its entry is still there to
+     * describe it */
+    if (_currentService != NULL && removedPaths.contains(_currentService->dbusPath())) {
+        sendConnectionStatusToSubscribers("notAssociated");
+        dropCurrentService();
+    }
+
+    /* Has to come before anything else connects to the services */
+    _serviceTable.update(networks);
+
+    foreach (const QString& path, removedPaths) {
+        /* A profile stays known while its network is out of range */
+        _profiles.detachService(path);
+
+        _scanResults.invalidate(path);
+
+        replyToConnectRequests(path, false, "Network is not available anymore");
     }
 
-    foreach (ServiceProfile *profile, profilesToRemove) {
-        _profiles.removeProfileById(profile->id());
+    /* A service object for a path we saw before might have been recreated in the
+     * meantime so we can't trust anything we've cached for it */
+    foreach (const QString& path, addedPaths) {
+        _scanResults.invalidate(path);
+
+        _profiles.attachService(_wifiServices.findByPath(path));
+
+        /* hidden networks get their name once we're connected to them */
+        connect(_wifiServices.findByPath(path), SIGNAL(nameChanged(QString)),
+                this, SLOT(wifiServiceNameChanged()), Qt::UniqueConnection);
     }
+
+    if (_networkSubscribers > 0)
+        scheduleNetworkChanges();
+
+    /* Only the manager reporting its services tells us it got connman's state; our
+     * own call from the constructor doesn't */
+    if (!_startupFinished && sender() == _manager)
+        finishStartup();
+}
+
+void WifiNetworkService::wifiServiceNameChanged()
+{
+    NetworkService *service = qobject_cast<NetworkService*>(sender());
+
+    _metrics.countSignal(AdapterMetrics::SIGNAL_NAME_CHANGED);
+
+    _wifiServices.updateNameIndex();
+
+    /* Profiles of hidden networks learn their name this way */
+    if (service != NULL)
+        _profiles.attachService(service);
+
+    /* The cached status carries the ssid of the current service */
+    if (service != NULL && service == _currentService)
+        markStatusChanged();
 }
 
 void WifiNetworkService::managerAvailabilityChanged(bool available)
 {
+    _metrics.countSignal(AdapterMetrics::SIGNAL_AVAILABILITY_CHANGED);
+
     /* FIXME disable service and send signals */
 }
 
 void WifiNetworkService::wifiPoweredChanged(bool powered)
 {
-    json_object *response;
-    const char *payload;
-    LSError lserror;
+    QList<QByteArray> keys;
 
-    LSErrorInit(&lserror);
+    _metrics.countSignal(AdapterMetrics::SIGNAL_POWERED_CHANGED);
 
     if (!powered &&
         _currentService != NULL &&
@@ -155,40 +470,51 @@ void WifiNetworkService::wifiPoweredChanged(bool powered)
         sendConnectionStatusToSubscribers("notAssociated");
     }
 
-    _currentService = NULL;
-    _stateOfCurrentService = IDLE;
+    dropCurrentService();
 
-    response = json_object_new_object();
-    json_object_object_add(response, "returnValue", json_object_new_boolean(true));
-    json_object_object_add(response, "status",
-        json_object_new_string(powered ? "serviceEnabled" : "serviceDisabled"));
-    json_object_object_add(response, "wakeOnWlan", json_object_new_string("disabled"));
-    payload = json_object_to_json_string(response);
+    /* A powered down radio will never finish the scan our callers are waiting for */
+    if (!powered) {
+        cancelPendingScans();
+        _scanResults.clear();
 
-    if (!LSSubscriptionPost(_privateService, "/", "getstatus", payload, &lserror)) {
-        LSErrorPrint(&lserror, stderr);
-        LSErrorFree(&lserror);
+        cancelConnectRequests();
     }
 
-    /* FIXME should we post to public subscribers as well? */
+    /* Whatever happened before wifi went on or off has to reach subscribers first */
+    flushCoalescedPosts();
+
+    _statusSubscriptions.keysFor(STATUS_EVENT_SERVICE_STATE, 0, keys);
+    if (keys.isEmpty())
+        return;
+
+    JsonWriter& response = beginResponse();
+
+    response.beginObject();
+    response.member("returnValue", true);
+    response.member("status", powered ? "serviceEnabled" : "serviceDisabled");
+    response.member("wakeOnWlan", "disabled");
+    response.endObject();
+
+    postStatusToSubscribers(keys, response.data(), response.length());
 
-    if (response && !is_error(response))
-        json_object_put(response);
+    /* FIXME should we post to public subscribers as well? */
 }
 
 void WifiNetworkService::wifiConnectedChanged(const bool &connected)
 {
     QString state;
 
+    _metrics.countSignal(AdapterMetrics::SIGNAL_CONNECTED_CHANGED);
+
     /* When wifi is not connected anymore and we are connected to a wifi service we will
      * get this information already through the service object and can ignore it here */
     if (!connected)
         return;
 
     foreach(NetworkService *service, listNetworks()) {
-        if (service->state() == "ready" || service->state() == "online") {
+        if (serviceState(service) == READY || serviceState(service) == ONLINE) {
             /* We can safely ignore status updates for our current connected service */
-            if (_currentService && _currentService->dbusPath() == service->dbusPath()) {
+            if (_currentService == service) {
                 break;
             }
             else {
@@ -201,7 +527,7 @@ void WifiNetworkService::wifiConnectedChanged(const bool &connected)
 
                 assignCurrentService(service);
 
-                state = convert_connman_service_state_to_palm(_stateOfCurrentService);
+                state = palmServiceState(_currentService);
                 sendConnectionStatusToSubscribers(state);
 
                 break;
@@ -210,31 +536,29 @@ void WifiNetworkService::wifiConnectedChanged(const bool &connected)
     }
 }
 
-bool WifiNetworkService::checkForConnmanService(json_object *response)
+bool WifiNetworkService::checkForConnmanService(JsonWriter& response)
 {
     if (!_manager->isAvailable()) {
         qDebug() << "Connman service is not available; returning with error!";
 
         /* FIXME error codes are unknown right now so sending 1 as default */
-        json_object_object_add(response, "errorCode", json_object_new_int(1));
-        json_object_object_add(response, "errorText", json_object_new_string("Connman service is not availalbe"));
+        response.member("errorCode", 1);
+        response.member("errorText", "Connman service is not availalbe");
         return false;
     }
 
     return true;
 }
 
-QList<NetworkService*> WifiNetworkService::listNetworks() const
+JsonWriter& WifiNetworkService::beginResponse()
 {
-    const QString wifiTypeName(WIFI_TECHNOLOGY_NAME);
-    QList<NetworkService*> networks;
-
-    foreach(NetworkService *network, _manager->getServices()) {
-        if (network->type() == wifiTypeName)
-            networks.append(network);
-    }
+    _responseWriter.reset();
+    return _responseWriter;
+}
 
-    return networks;
+const QList<NetworkService*>& WifiNetworkService::listNetworks() const
+{
+    return _wifiServices.services();
 }
 
 bool WifiNetworkService::isWifiPowered() const
@@ -250,13 +574,50 @@ bool WifiNetworkService::setWifiPowered(const bool &powered)
         _wifiTechnology->setPowered(powered);
 }
 
+/* The service object might outlive its entry in connman's list so it must not be
+ * able to reach us anymore once we let it go */
+void WifiNetworkService::dropCurrentService()
+{
+    disconnectCurrentService();
+
+    _currentService = NULL;
+    _stateOfCurrentService = IDLE;
+    markStatusChanged();
+
+    /* Held back posts are about the service we just let go of; a disconnect was
+     * posted (and flushed them) already if it was connected */
+    _pendingConnectionState.clear();
+    _pendingStrength = false;
+}
+
+/* Nothing the former current service reports must reach our subscribers anymore */
+void WifiNetworkService::disconnectCurrentService()
+{
+    if (_currentService == NULL)
+        return;
+
+    disconnect(_currentService, SIGNAL(stateChanged(const QString&)), this, SLOT(currentServiceStateChanged(const QString&)));
+    disconnect(_currentService, SIGNAL(strengthChanged(const uint)), this, SLOT(currentServiceStrengthChanged(const uint)));
+    disconnect(_currentService, SIGNAL(ipv4Changed(QVariantMap)), this, SLOT(currentServiceIpv4Changed()));
+}
+
 void WifiNetworkService::assignCurrentService(NetworkService *service)
 {
+    disconnectCurrentService();
+
     _currentService = service;
-    _stateOfCurrentService = parse_connman_service_state(_currentService->state().toUtf8().constData());
+    _stateOfCurrentService = serviceState(_currentService);
 
-    connect(_currentService, SIGNAL(stateChanged(const QString&)), this, SLOT(currentServiceStateChanged(const QString&)));
-    connect(_currentService, SIGNAL(strengthChanged(const uint)), this, SLOT(currentServiceStrengthChanged(const uint)));
+    connect(_currentService, SIGNAL(stateChanged(const QString&)), this, SLOT(currentServiceStateChanged(const QString&)),
+            Qt::UniqueConnection);
+    connect(_currentService, SIGNAL(strengthChanged(const uint)), this, SLOT(currentServiceStrengthChanged(const uint)),
+            Qt::UniqueConnection);
+    connect(_currentService, SIGNAL(ipv4Changed(QVariantMap)), this, SLOT(currentServiceIpv4Changed()),
+            Qt::UniqueConnection);
+
+    markStatusChanged();
+
+    _strengthPublisher.reset(serviceStrength(_currentService));
 
     _connectionSettings.reset();
 }
@@ -265,39 +626,70 @@ void WifiNetworkService::currentServiceStateChanged(const QString &changedState)
 {
     int newState;
     QString palmState;
-    LSError lserror;
+    QString path;
 
-    LSErrorInit(&lserror);
+    _metrics.countSignal(AdapterMetrics::SIGNAL_STATE_CHANGED);
 
-    newState = parse_connman_service_state(_currentService->state().toUtf8().constData());
+    if (_currentService == NULL)
+        return;
 
-    palmState = convert_connman_service_state_to_palm(newState, _stateOfCurrentService);
+    path = _currentService->dbusPath();
 
-    qDebug() << "currentServiceStateChanged: palmState = " << palmState << " state = " << changedState;
+    markStatusChanged();
 
-    if (newState == CONFIGURATION && _connectServiceRequest.valid) {
-        /* We're now successfully associated with the network so we can complete the
-         * connect request from the user. */
-        json_object_object_add(_connectServiceRequest.response, "returnValue",
-            json_object_new_boolean(true));
+    newState = serviceState(_currentService);
 
-        if (!LSMessageReply(_connectServiceRequest.handle, _connectServiceRequest.message,
-                json_object_to_json_string(_connectServiceRequest.response), &lserror)) {
-            LSErrorPrint(&lserror, stderr);
-            LSErrorFree(&lserror);
-        }
+    _trace.instant("serviceStateChanged", newState);
+
+    palmState = palmServiceState(_currentService);
+
+    qDebug() << "currentServiceStateChanged: palmState = " << palmState << " state = " << changedState;
+
+    switch (newState) {
+    case ASSOCIATION:
+        _connectTimings.mark(path, ConnectTimings::PHASE_ASSOCIATION);
+        break;
+    case CONFIGURATION:
+        _connectTimings.mark(path, ConnectTimings::PHASE_CONFIGURATION);
+        break;
+    case READY:
+        _connectTimings.mark(path, ConnectTimings::PHASE_READY);
+        break;
+    case ONLINE:
+        _connectTimings.mark(path, ConnectTimings::PHASE_ONLINE);
+        break;
+    default:
+        break;
+    }
 
-        json_object_put(_connectServiceRequest.response);
+    if (newState == CONFIGURATION && _connectRequests.hasPending(path)) {
+        /* We're now successfully associated with the network so we can complete the
+         * connect requests from the user. */
+        replyToConnectRequests(path, true, QString());
 
         /* That means we can take the service as new profile as well */
-        if (_profiles.findProfileByDBusPath(_currentService->dbusPath()) != NULL) {
+        if (_profiles.findProfileByDBusPath(path) == NULL) {
             ServiceProfile *profile = _profiles.createProfile(_currentService);
             qDebug() << "New profile: service = " << profile->dbusPath() << " id = " << profile->id();
 
+            _scanResults.invalidate(profile->dbusPath());
+            markStatusChanged();
+
             _currentService->setAutoConnect(true);
         }
+    }
+    else if (newState == FAILURE) {
+        /* Errors connman reports through our agent already answered the request; this
+         * is for anything else which let the connect fail */
+        replyToConnectRequests(path, false, "Failed to connect to network");
+    }
 
-        _connectServiceRequest.reset();
+    /* Once the attempt has come to an end its timings go into the histograms */
+    if (_connectTimings.isTracking(path)) {
+        if (newState == ONLINE)
+            _connectTimings.finish(ConnectTimings::OUTCOME_SUCCEEDED);
+        else if (newState == FAILURE || newState == IDLE || newState == DISCONNECT)
+            _connectTimings.finish(ConnectTimings::OUTCOME_FAILED);
     }
 
     sendConnectionStatusToSubscribers(palmState);
@@ -307,236 +699,420 @@ void WifiNetworkService::currentServiceStateChanged(const QString &changedState)
 
 void WifiNetworkService::currentServiceStrengthChanged(const uint strength)
 {
-    sendConnectionStrengthToSubscribers(strength);
+    _metrics.countSignal(AdapterMetrics::SIGNAL_STRENGTH_CHANGED);
+    _trace.instant("strengthChanged", strength);
+
+    markStatusChanged();
+
+    /* Without subscribers there is nobody to throttle updates for; the publisher only
+     * has to know where to start from once somebody subscribes */
+    if (!_statusSubscriptions.wants(STATUS_EVENT_SIGNAL_STRENGTH))
+        _strengthPublisher.reset(strength);
+    else
+        _strengthPublisher.update(strength);
 }
 
-void WifiNetworkService::appendConnectionStatusToMessage(json_object *message, NetworkService *service, const QString& state)
+void WifiNetworkService::currentServiceIpv4Changed()
 {
-    json_object *networkInfo;
-    json_object *ipInfo;
-    json_object *apInfo;
-    QVariantMap ipInfoMap;
-    QStringList nameserverList;
-    QString nameserver;
-    ServiceProfile *profile;
+    _metrics.countSignal(AdapterMetrics::SIGNAL_IPV4_CHANGED);
 
-    json_object_object_add(message, "status", json_object_new_string("connectionStateChanged"));
+    markStatusChanged();
+}
 
-    networkInfo = json_object_new_object();
+void WifiNetworkService::publishStrength(unsigned int strength, unsigned int signalBars)
+{
+    /* A held back update can arrive after we lost our service */
+    if (_currentService == NULL)
+        return;
 
-    profile = _profiles.findProfileByDBusPath(service->dbusPath());
-    if (profile != NULL) {
-        json_object_object_add(networkInfo, "profileId", json_object_new_int(profile->id()));
-    }
+    sendConnectionStrengthToSubscribers(strength, signalBars);
+}
 
-    json_object_object_add(networkInfo, "ssid",
-        json_object_new_string(service->name().toUtf8().constData()));
-    json_object_object_add(networkInfo, "securityType", json_object_new_string(""));
-    json_object_object_add(networkInfo, "connectState", json_object_new_string(state.toUtf8().constData()));
-    json_object_object_add(networkInfo, "signalBars",
-            json_object_new_int((service->strength() * MAX_SIGNAL_BARS) / 100));
-    json_object_object_add(networkInfo, "signalLevel", json_object_new_int(service->strength()));
-    json_object_object_add(networkInfo, "lastConnectError", json_object_new_string(""));
+int WifiNetworkService::serviceState(NetworkService *service) const
+{
+    const ConnmanServiceInfo *info = _serviceTable.find(service);
 
-    json_object_object_add(message, "networkInfo", networkInfo);
+    if (info == NULL)
+        return IDLE;
 
-    if (state == "ipConfigured") {
-        ipInfo = json_object_new_object();
+    return info->state;
+}
 
-        /* FIXME we need to determine the interface via the technology API */
-        json_object_object_add(ipInfo, "interface", json_object_new_string("wlan0"));
+unsigned int WifiNetworkService::serviceStrength(NetworkService *service) const
+{
+    const ConnmanServiceInfo *info = _serviceTable.find(service);
 
-        ipInfoMap = service->ipv4();
-        json_object_object_add(ipInfo, "ip", json_object_new_string(ipInfoMap["Address"].toByteArray().constData()));
-        json_object_object_add(ipInfo, "subnet", json_object_new_string(ipInfoMap["Netmask"].toByteArray().constData()));
-        json_object_object_add(ipInfo, "gateway", json_object_new_string(ipInfoMap["Gateway"].toByteArray().constData()));
+    if (info == NULL)
+        return 0;
 
-        /* pick first nameserver from the list as it's the one currently used */
-        nameserverList = ipInfoMap["Nameservers"].toStringList();
-        if (!nameserverList.isEmpty()) {
-            nameserver = nameserverList.first();
+    return info->strength;
+}
 
-            json_object_object_add(ipInfo, "dns1",
-                json_object_new_string(nameserver.toUtf8().constData()));
-        }
+/* Failures are told apart by the state the service was in before */
+const char* WifiNetworkService::palmServiceState(NetworkService *service) const
+{
+    const ConnmanServiceInfo *info = _serviceTable.find(service);
 
-        json_object_object_add(message, "ipInfo", ipInfo);
-    }
+    if (info == NULL)
+        return convert_connman_service_state_to_palm(IDLE);
+
+    return convert_connman_service_state_to_palm(info->state, info->history.previousState());
 }
 
-void WifiNetworkService::sendConnectionStatusToSubscribers(const QString& state)
+void WifiNetworkService::appendConnectionStatusToMessage(JsonWriter& message, NetworkService *service, const QString& state)
 {
-    json_object *serviceStatus;
-    const char *payload;
-    LSError lserror;
+    const ConnmanServiceInfo *info = _serviceTable.find(service);
+    ServiceProfile *profile;
 
-    serviceStatus = json_object_new_object();
+    message.member("status", "connectionStateChanged");
 
-    json_object_object_add(serviceStatus, "returnValue", json_object_new_boolean(true));
-    appendConnectionStatusToMessage(serviceStatus, _currentService, state);
+    if (info == NULL)
+        return;
 
-    payload = json_object_to_json_string(serviceStatus);
+    message.key("networkInfo").beginObject();
 
-    if (!LSSubscriptionPost(_privateService, "/", "getstatus", payload, &lserror)) {
-        LSErrorPrint(&lserror, stderr);
-        LSErrorFree(&lserror);
+    profile = _profiles.findProfileByDBusPath(info->path);
+    if (profile != NULL) {
+        message.member("profileId", profile->id());
     }
 
-    json_object_put(serviceStatus);
-}
+    message.member("ssid", info->name);
+    message.member("securityType", "");
+    message.member("connectState", state);
+    message.member("signalBars", convert_strength_to_signal_bars(info->strength));
+    message.member("signalLevel", info->strength);
+    message.member("lastConnectError", "");
 
-void WifiNetworkService::sendConnectionStrengthToSubscribers(const uint strength)
-{
-    json_object *serviceStatus;
-    const char *payload;
-    LSError lserror;
+    message.endObject();
+
+    if (state == "ipConfigured") {
+        message.key("ipInfo").beginObject();
 
-    serviceStatus = json_object_new_object();
+        /* FIXME we need to determine the interface via the technology API */
+        message.member("interface", "wlan0");
 
-    json_object_object_add(serviceStatus, "returnValue", json_object_new_boolean(true));
-    json_object_object_add(serviceStatus, "status", json_object_new_string("signalStrengthChanged"));
-    json_object_object_add(serviceStatus, "signalBars", json_object_new_int((_currentService->strength() * MAX_SIGNAL_BARS) / 100));
-    json_object_object_add(serviceStatus, "signalLevel", json_object_new_int(_currentService->strength()));
+        message.member("ip", info->address);
+        message.member("subnet", info->netmask);
+        message.member("gateway", info->gateway);
 
-    payload = json_object_to_json_string(serviceStatus);
+        if (!info->nameserver.isEmpty()) {
+            message.member("dns1", info->nameserver);
+        }
 
-    if (!LSSubscriptionPost(_privateService, "/", "getstatus", payload, &lserror)) {
-        LSErrorPrint(&lserror, stderr);
-        LSErrorFree(&lserror);
+        message.endObject();
     }
-
-    json_object_put(serviceStatus);
 }
 
-bool WifiNetworkService::connectWithSsid(const QString& ssid, json_object *request, json_object *response)
+void WifiNetworkService::markStatusChanged()
 {
-    json_object *wasCreatedWithJoinOther;
-    json_object *security;
-    json_object *securityType;
-    json_object *ssidObj;
-    json_object *simpleSecurity;
-    json_object *enterpriseSecurity;
-    json_object *passKey;
-    json_object *keyIndex;
-    bool success = false;
+    _statusVersion++;
+}
 
-    /* Ok, we have several cases to handle here:
-     * 1. Open
-     * 2. WEP
-     * 3. Pre-shared key
-     * 4. Enterprise networks */
+const QByteArray& WifiNetworkService::statusSnapshot()
+{
+    QString state;
 
-    /* We want to connect to an open network without any security enabled */
-    foreach (NetworkService *service, listNetworks()) {
-        if (service->name() == ssid) {
-            /* Be sure we're not yet connected to the network */
-            if (service->state() != "idle" && service->state() != "failure") {
-                json_object_object_add(response, "errorText",
-                    json_object_new_string("Trying to connect to a network not in idle state"));
-                break;
-            }
+    if (_statusSnapshotVersion == _statusVersion && !_statusSnapshot.isEmpty())
+        return _statusSnapshot;
 
-            if (_currentService != NULL) {
-                /* Don't get any signals from former connected network anymore */
-                disconnect(_currentService, SIGNAL(stateChanged(const QString&)), this, SLOT(currentServiceStateChanged(const QString&)));
-            }
+    JsonWriter& response = beginResponse();
 
-            assignCurrentService(service);
+    response.beginObject();
+    response.member("returnValue", true);
+    response.member("wakeOnWlan", "disabled");
 
-            wasCreatedWithJoinOther = json_object_object_get(request, "wasCreatedWithJoinOther");
-            if (wasCreatedWithJoinOther) {
-                _connectionSettings.hiddenNetwork = json_object_get_boolean(wasCreatedWithJoinOther);
-            }
+    if (isWifiPowered() && _currentService != NULL) {
+        state = palmServiceState(_currentService);
+        appendConnectionStatusToMessage(response, _currentService, state);
+    }
+    else {
+        response.member("status", isWifiPowered() ? "serviceEnabled" : "serviceDisabled");
+    }
 
-            ssidObj = json_object_object_get(request, "ssid");
-            if (!ssidObj) {
-                json_object_object_add(response, "errorText", json_object_new_string("No ssid provided to connect to network"));
-                break;
-            }
-            _connectionSettings.name = json_object_get_string(ssidObj);
-
-            security = json_object_object_get(request, "security");
-            if (security) {
-                securityType = json_object_object_get(security, "securityType");
-                _connectionSettings.setupFromPalmSecurityType(QString(json_object_get_string(securityType)));
-
-                if (_connectionSettings.securityType == ConnectionSettings::WEP ||
-                    _connectionSettings.securityType == ConnectionSettings::PSK) {
-                    simpleSecurity = json_object_object_get(security, "simpleSecurity");
-                    if (!simpleSecurity) {
-                        json_object_object_add(response, "errorText",
-                            json_object_new_string("Indicated simple security type but no settings provided"));
-                        break;
-                    }
-
-                    passKey = json_object_object_get(simpleSecurity, "passKey");
-                    if (!passKey) {
-                        json_object_object_add(response, "errorText",
-                            json_object_new_string("No passkey for network security provided"));
-                        break;
-                    }
-
-                    /* FIXME take isInHex parameter in advance too */
-                    _connectionSettings.passphrase = json_object_get_string(passKey);
-
-                    if (_connectionSettings.securityType == ConnectionSettings::WEP) {
-                        keyIndex = json_object_object_get(simpleSecurity, "keyIndex");
-                        if (!keyIndex) {
-                            json_object_object_add(response, "errorText",
-                                json_object_new_string("No key index provided but needed"));
-                            break;
-                        }
-
-                        _connectionSettings.keyIndex = json_object_get_int(keyIndex);
-                    }
-                }
-                else if (_connectionSettings.securityType == ConnectionSettings::IEEE8021x)
-                {
-                    json_object_object_add(response, "errorText",
-                        json_object_new_string("Networks with enterprise security are not support yet"));
-                    break;
-                }
-            }
+    response.endObject();
 
-            /* Any further work is handled by the agent instance we connected to connman */
-            _currentService->requestConnect();
-            success = true;
-            break;
-        }
-    }
+    /* Deep copy as the writer's buffer gets reused for the next message */
+    _statusSnapshot = response.toByteArray();
+    _statusSnapshotVersion = _statusVersion;
 
-    return success;
+    return _statusSnapshot;
 }
 
-bool WifiNetworkService::connectWithProfileId(int id, json_object *response)
+const QByteArray& WifiNetworkService::connectionStatusSnapshot(const QString& state)
 {
-    ServiceProfile *profile;
-    bool success = false;
+    if (_connectionStatusSnapshotVersion == _statusVersion &&
+        _connectionStatusSnapshotState == state && !_connectionStatusSnapshot.isEmpty())
+        return _connectionStatusSnapshot;
 
-    profile = _profiles.findProfileById(id);
-    if (profile == NULL) {
-        json_object_object_add(response, "errorText", json_object_new_string("Invalid profile id provided"));
-        return false;
-    }
+    JsonWriter& serviceStatus = beginResponse();
 
-    foreach(NetworkService *service, listNetworks()) {
-        if (service->dbusPath() == profile->dbusPath()) {
-            assignCurrentService(service);
-            _currentService->requestConnect();
-            success = true;
-            break;
+    serviceStatus.beginObject();
+    serviceStatus.member("returnValue", true);
+    appendConnectionStatusToMessage(serviceStatus, _currentService, state);
+    serviceStatus.endObject();
+
+    _connectionStatusSnapshot = serviceStatus.toByteArray();
+    _connectionStatusSnapshotState = state;
+    _connectionStatusSnapshotVersion = _statusVersion;
+
+    return _connectionStatusSnapshot;
+}
+
+void WifiNetworkService::postStatusToSubscribers(const QList<QByteArray>& keys, const char *payload, int length)
+{
+    LSError lserror;
+
+    LSErrorInit(&lserror);
+
+    foreach (const QByteArray& key, keys) {
+        _metrics.countPost(length);
+        _trace.instant("subscriptionPost", length);
+
+        if (!LSSubscriptionReply(_privateService, key.constData(), payload, &lserror)) {
+            LSErrorPrint(&lserror, stderr);
+            LSErrorFree(&lserror);
         }
     }
+}
+
+void WifiNetworkService::sendConnectionStatusToSubscribers(const QString& state)
+{
+    QList<QByteArray> keys;
+
+    if (!_statusSubscriptions.wants(STATUS_EVENT_CONNECTION_STATE))
+        return;
+
+    /* Failures and disconnects are never merged with anything else so subscribers
+     * see them even when the next state follows right away */
+    if (_coalesceWindow > 0 && state != "notAssociated" &&
+        state != "associationFailed" && state != "ipFailed") {
+        _pendingConnectionState = state;
+        scheduleCoalescedPost();
+        return;
+    }
 
-    return success;
+    flushCoalescedPosts();
+
+    _statusSubscriptions.keysFor(STATUS_EVENT_CONNECTION_STATE, 0, keys);
+    if (keys.isEmpty())
+        return;
+
+    const QByteArray& payload = connectionStatusSnapshot(state);
+
+    postStatusToSubscribers(keys, payload.constData(), payload.length());
 }
 
-void WifiNetworkService::provideInputForConnman(const QVariantMap& fields, const QDBusMessage& message)
+void WifiNetworkService::sendConnectionStrengthToSubscribers(const uint strength, const uint signalBars)
+{
+    QList<QByteArray> keys;
+
+    if (_coalesceWindow > 0) {
+        _pendingStrength = true;
+        _pendingStrengthValue = strength;
+        _pendingSignalBars = signalBars;
+        scheduleCoalescedPost();
+        return;
+    }
+
+    _statusSubscriptions.keysFor(STATUS_EVENT_SIGNAL_STRENGTH, signalBars, keys);
+    if (keys.isEmpty())
+        return;
+
+    postConnectionStrength(keys, strength, signalBars);
+}
+
+void WifiNetworkService::postConnectionStrength(const QList<QByteArray>& keys, const uint strength,
+                                                const uint signalBars)
+{
+    JsonWriter& serviceStatus = beginResponse();
+
+    serviceStatus.beginObject();
+    serviceStatus.member("returnValue", true);
+    serviceStatus.member("status", "signalStrengthChanged");
+    serviceStatus.member("signalBars", signalBars);
+    serviceStatus.member("signalLevel", strength);
+    serviceStatus.endObject();
+
+    postStatusToSubscribers(keys, serviceStatus.data(), serviceStatus.length());
+}
+
+void WifiNetworkService::scheduleCoalescedPost()
+{
+    /* The window starts with the first held back change; later ones only update what
+     * will be posted */
+    if (_coalesceTimeout == 0)
+        _coalesceTimeout = g_timeout_add(_coalesceWindow, cbCoalesceTimeout, this);
+}
+
+void WifiNetworkService::flushCoalescedPosts()
+{
+    QList<QByteArray> stateKeys;
+    QList<QByteArray> strengthKeys;
+
+    if (_coalesceTimeout != 0) {
+        g_source_remove(_coalesceTimeout);
+        _coalesceTimeout = 0;
+    }
+
+    if (!_pendingConnectionState.isEmpty()) {
+        _statusSubscriptions.keysFor(STATUS_EVENT_CONNECTION_STATE, 0, stateKeys);
+        if (!stateKeys.isEmpty()) {
+            const QByteArray& payload = connectionStatusSnapshot(_pendingConnectionState);
+            postStatusToSubscribers(stateKeys, payload.constData(), payload.length());
+        }
+
+        _pendingConnectionState.clear();
+    }
+
+    if (_pendingStrength) {
+        _statusSubscriptions.keysFor(STATUS_EVENT_SIGNAL_STRENGTH, _pendingSignalBars, strengthKeys);
+
+        /* The connection state post carried the latest strength already */
+        foreach (const QByteArray& key, stateKeys)
+            strengthKeys.removeAll(key);
+
+        if (!strengthKeys.isEmpty())
+            postConnectionStrength(strengthKeys, _pendingStrengthValue, _pendingSignalBars);
+
+        _pendingStrength = false;
+    }
+}
+
+gboolean WifiNetworkService::cbCoalesceTimeout(gpointer user_data)
+{
+    WifiNetworkService *self = (WifiNetworkService*) user_data;
+
+    self->_coalesceTimeout = 0;
+    self->flushCoalescedPosts();
+
+    return FALSE;
+}
+
+const char* WifiNetworkService::cbConnectTimeout(const QString& servicePath, void *user_data)
+{
+    WifiNetworkService *self = (WifiNetworkService*) user_data;
+
+    self->_metrics.countError("Connect");
+
+    JsonWriter& response = self->beginResponse();
+
+    response.beginObject();
+    response.member("returnValue", false);
+    response.member("errorText", "Timeout while connecting to network");
+
+    /* The caller gave up on the attempt so it ends here as far as the timings go */
+    if (self->_connectTimings.isTracking(servicePath)) {
+        response.key("timing");
+        self->_connectTimings.appendToMessage(response);
+        self->_connectTimings.finish(ConnectTimings::OUTCOME_TIMED_OUT);
+    }
+
+    response.endObject();
+
+    return response.data();
+}
+
+bool WifiNetworkService::connectWithSsid(const QString& ssid, const RequestParser& request, QString& errorText)
+{
+    NetworkService *service;
+
+    /* Ok, we have several cases to handle here:
+     * 1. Open
+     * 2. WEP
+     * 3. Pre-shared key
+     * 4. Enterprise networks */
+
+    service = _wifiServices.findByName(ssid);
+    if (service == NULL)
+        return false;
+
+    /* Be sure we're not yet connected to the network */
+    if (serviceState(service) != IDLE && serviceState(service) != FAILURE) {
+        errorText = "Trying to connect to a network not in idle state";
+        return false;
+    }
+
+    assignCurrentService(service);
+
+    if (request.has(CONNECT_WAS_CREATED_WITH_JOIN_OTHER)) {
+        _connectionSettings.hiddenNetwork = request.boolValue(CONNECT_WAS_CREATED_WITH_JOIN_OTHER);
+    }
+
+    _connectionSettings.name = ssid;
+
+    if (request.has(CONNECT_SECURITY)) {
+        _connectionSettings.setupFromPalmSecurityType(request.stringValue(CONNECT_SECURITY_TYPE));
+
+        if (_connectionSettings.securityType == ConnectionSettings::WEP ||
+            _connectionSettings.securityType == ConnectionSettings::PSK) {
+            if (!request.has(CONNECT_SIMPLE_SECURITY)) {
+                errorText = "Indicated simple security type but no settings provided";
+                return false;
+            }
+
+            if (!request.has(CONNECT_PASSKEY)) {
+                errorText = "No passkey for network security provided";
+                return false;
+            }
+
+            /* FIXME take isInHex parameter in advance too */
+            _connectionSettings.passphrase = request.stringValue(CONNECT_PASSKEY);
+
+            if (_connectionSettings.securityType == ConnectionSettings::WEP) {
+                if (!request.has(CONNECT_KEY_INDEX)) {
+                    errorText = "No key index provided but needed";
+                    return false;
+                }
+
+                _connectionSettings.keyIndex = request.intValue(CONNECT_KEY_INDEX);
+            }
+        }
+        else if (_connectionSettings.securityType == ConnectionSettings::IEEE8021x)
+        {
+            errorText = "Networks with enterprise security are not support yet";
+            return false;
+        }
+    }
+
+    /* Any further work is handled by the agent instance we connected to connman */
+    _currentService->requestConnect();
+
+    return true;
+}
+
+bool WifiNetworkService::connectWithProfileId(int id, QString& errorText)
+{
+    ServiceProfile *profile;
+    NetworkService *service;
+
+    profile = _profiles.findProfileById(id);
+    if (profile == NULL) {
+        errorText = "Invalid profile id provided";
+        return false;
+    }
+
+    service = _wifiServices.findByPath(profile->dbusPath());
+    if (service == NULL) {
+        errorText = "Network of the profile is not in range";
+        return false;
+    }
+
+    assignCurrentService(service);
+    _currentService->requestConnect();
+
+    return true;
+}
+
+void WifiNetworkService::provideInputForConnman(const QString& servicePath, const QVariantMap& fields,
+                                                const QDBusMessage& message)
 {
     QDBusMessage reply = message.createReply();
     QDBusMessage error;
     QVariantMap responseFields;
 
+    _trace.instant("agentRequestInput");
+    _connectTimings.mark(servicePath, ConnectTimings::PHASE_REQUEST_INPUT);
+
     /* FIXME check provided service path with the one we're connecting to */
 
     if (fields.contains("Passphrase")) {
@@ -559,340 +1135,867 @@ void WifiNetworkService::provideInputForConnman(const QVariantMap& fields, const
     QDBusConnection::systemBus().send(reply);
 }
 
-void WifiNetworkService::processErrorFromConnman(const QString& error)
+void WifiNetworkService::processErrorFromConnman(const QString& servicePath, const QString& error)
+{
+    _trace.instant("agentReportError");
+    replyToConnectRequests(servicePath, false, error);
+}
+
+void WifiNetworkService::cancelConnectRequests()
+{
+    int count = _connectRequests.cancelAll();
+
+    while (count-- > 0)
+        _metrics.countError("Connect");
+
+    /* The attempt ends here even if connman already got past configuration */
+    _connectTimings.finish(ConnectTimings::OUTCOME_FAILED);
+}
+
+void WifiNetworkService::replyToConnectRequests(const QString& servicePath, bool success, const QString& errorText)
+{
+    if (!_connectRequests.hasPending(servicePath))
+        return;
+
+    if (!success)
+        _metrics.countError("Connect");
+
+    JsonWriter& response = beginResponse();
+
+    response.beginObject();
+    response.member("returnValue", success);
+    if (!success)
+        response.member("errorText", errorText);
+
+    /* Requests are answered at configuration at the latest, so ready and online
+     * only ever show up in the histograms of getmetrics */
+    if (_connectTimings.isTracking(servicePath)) {
+        response.key("timing");
+        _connectTimings.appendToMessage(response);
+    }
+
+    response.endObject();
+
+    _connectRequests.complete(servicePath, response.data());
+}
+
+void WifiNetworkService::appendProfileToMessage(JsonWriter& message, ServiceProfile *profile)
+{
+    message.beginObject();
+    message.key("wifiProfile").beginObject();
+
+    message.member("ssid", profile->name());
+    message.member("profileId", profile->id());
+
+    if (!profile->security().isEmpty()) {
+        message.key("security").beginObject();
+        message.member("securityType",
+            convert_connman_security_to_palm(parse_connman_security_type(profile->security())));
+        message.endObject();
+    }
+
+    /* NOTE: we're not supporting the simpleSecurity/enterpriseSecurity element */
+    /* NOTE: we're not supporting the RoamingHistogram element */
+
+    message.endObject();
+    message.endObject();
+}
+
+void WifiNetworkService::appendProfileListToMessage(JsonWriter& message)
+{
+    message.key("profileList").beginArray();
+
+    foreach(ServiceProfile* profile, _profiles.list()) {
+        appendProfileToMessage(message, profile);
+    }
+
+    message.endArray();
+}
+
+bool WifiNetworkService::processGetStatusMethod(LSHandle *handle, LSMessage *message)
+{
+    LSError lserror;
+    bool subscribed = false;
+    QByteArray payload;
+    QByteArray key;
+    StatusSubscriptions::Filter filter;
+    QString errorText;
+    unsigned int signalBars = 0;
+    bool baselineMoved = false;
+
+    LSErrorInit(&lserror);
+
+    if (LSMessageIsSubscription(message)) {
+        if (!StatusSubscriptions::parseFilter(LSMessageGetPayload(message), filter, errorText)) {
+            JsonWriter& response = beginResponse();
+
+            response.beginObject();
+            response.member("subscribed", false);
+            response.member("errorText", errorText);
+            response.member("returnValue", false);
+            response.endObject();
+
+            _metrics.countError("GetStatus");
+
+            if (!LSMessageReply(handle, message, response.data(), &lserror)) {
+                LSErrorPrint(&lserror, stderr);
+                LSErrorFree(&lserror);
+            }
+
+            return true;
+        }
+
+        if (_currentService != NULL)
+            signalBars = convert_strength_to_signal_bars(serviceStrength(_currentService));
+
+        /* Subscribers with the same filter share a key so they get the same posts */
+        key = _statusSubscriptions.add(filter, signalBars, baselineMoved);
+
+        /* Posted before the subscriber is added; it gets the bars with the reply */
+        if (baselineMoved && _currentService != NULL) {
+            QList<QByteArray> keys;
+
+            keys.append(key);
+            postConnectionStrength(keys, serviceStrength(_currentService), signalBars);
+        }
+
+        subscribed = LSSubscriptionAdd(handle, key.constData(), message, &lserror);
+        if (!subscribed) {
+            LSErrorPrint(&lserror, stderr);
+            LSErrorFree(&lserror);
+            _statusSubscriptions.remove(filter);
+        }
+    }
+
+    if (!_manager->isAvailable()) {
+        JsonWriter& response = beginResponse();
+
+        response.beginObject();
+
+        if (LSMessageIsSubscription(message))
+            response.member("subscribed", subscribed);
+
+        checkForConnmanService(response);
+        response.member("returnValue", false);
+        response.endObject();
+
+        _metrics.countError("GetStatus");
+
+        payload = response.toByteArray();
+    }
+    else if (LSMessageIsSubscription(message)) {
+        /* The snapshot is a complete JSON object so we only have to put the subscription
+         * state in front of its first member */
+        payload = subscribed ? "{\"subscribed\":true," : "{\"subscribed\":false,";
+        payload.append(statusSnapshot().constData() + 1);
+    }
+    else {
+        payload = statusSnapshot();
+    }
+
+    if (!LSMessageReply(handle, message, payload.constData(), &lserror)) {
+        LSErrorPrint(&lserror, stderr);
+        LSErrorFree(&lserror);
+    }
+
+    return true;
+}
+
+bool WifiNetworkService::processSetStateMethod(LSHandle *handle, LSMessage *message)
 {
+    RequestParser request(_setStateFields, FIELD_COUNT(_setStateFields));
+    QString stateValue;
     LSError lserror;
+    bool success = false;
 
     LSErrorInit(&lserror);
 
-    if (_connectServiceRequest.valid) {
-        json_object_object_add(_connectServiceRequest.response, "returnValue",
-            json_object_new_boolean(false));
+    const char* str = LSMessageGetPayload(message);
+    if( !str )
+        return false;
+
+    JsonWriter& response = beginResponse();
+
+    response.beginObject();
 
-        json_object_object_add(_connectServiceRequest.response, "errorText",
-            json_object_new_string(error.toUtf8().constData()));
+    if (!checkForConnmanService(response))
+        goto done;
 
-        if (!LSMessageReply(_connectServiceRequest.handle, _connectServiceRequest.message,
-                json_object_to_json_string(_connectServiceRequest.response), &lserror)) {
+    if (!request.parse(str)) {
+        response.member("errorText", request.errorText());
+        goto done;
+    }
+
+    stateValue = request.stringValue(SETSTATE_STATE);
+
+    if (stateValue.isEmpty() || (stateValue != "enabled" && stateValue != "disabled")) {
+        response.member("errorCode", 1);
+        response.member("errorText", "InvalidStateValue");
+        goto done;
+    }
+
+    if (stateValue == "enabled" && isWifiPowered()) {
+        response.member("errorCode", 15);
+        response.member("errorText", "AlreadyEnabled");
+        goto done;
+    }
+    else if (stateValue == "disabled" && !isWifiPowered()) {
+        success = true;
+        goto done;
+    }
+
+    setWifiPowered(stateValue == "enabled" ? true : false);
+
+    success = true;
+
+done:
+    if (!success)
+        _metrics.countError("SetState");
+
+    response.member("returnValue", success);
+    response.endObject();
+
+    LSMessageReply(handle, message, response.data(), &lserror);
+
+    return true;
+}
+
+QByteArray WifiNetworkService::createNetworkEntry(NetworkService *service, const ConnmanServiceInfo& info)
+{
+    JsonWriter network(192);
+    const char *connectState = NULL;
+    const char *security = NULL;
+    ServiceProfile *profile = NULL;
+
+    network.beginObject();
+    network.key("networkInfo").beginObject();
+
+    profile = _profiles.findProfileByDBusPath(info.path);
+    if (profile != NULL) {
+        network.member("profileId", profile->id());
+    }
+    else if (info.favorite) {
+        profile = _profiles.createProfile(service);
+        qDebug() << "New profile: service = " << profile->dbusPath() << " id = " << profile->id();
+
+        if (service == _currentService)
+            markStatusChanged();
+
+        network.member("profileId", profile->id());
+    }
+
+    /* default values needed for each entry */
+    network.member("ssid", info.name);
+
+    security = convert_connman_security_to_palm(info.security);
+    if (security) {
+        network.member("securityType", security);
+    }
+
+    network.member("signalBars", convert_strength_to_signal_bars(info.strength));
+    network.member("signalLevel", info.strength);
+
+    /* Same mapping as for the connection status; networks we're not connected to
+     * don't report a state at all */
+    connectState = convert_connman_service_state_to_palm(info.state, info.history.previousState());
+    if (strcmp(connectState, "notAssociated") != 0) {
+        network.member("connectState", connectState);
+    }
+
+    network.endObject();
+    network.endObject();
+
+    /* Any change of the properties we're reporting makes the cached entry stale */
+    connect(service, SIGNAL(nameChanged(QString)), this, SLOT(scanResultChanged()), Qt::UniqueConnection);
+    connect(service, SIGNAL(stateChanged(QString)), this, SLOT(scanResultChanged()), Qt::UniqueConnection);
+    connect(service, SIGNAL(strengthChanged(uint)), this, SLOT(scanResultChanged()), Qt::UniqueConnection);
+    connect(service, SIGNAL(securityChanged(QStringList)), this, SLOT(scanResultChanged()), Qt::UniqueConnection);
+    connect(service, SIGNAL(favoriteChanged(bool)), this, SLOT(scanResultChanged()), Qt::UniqueConnection);
+
+    return network.toByteArray();
+}
+
+QByteArray WifiNetworkService::networkEntry(NetworkService *service, const ConnmanServiceInfo& info)
+{
+    QByteArray network = _scanResults.entry(info.path);
+
+    if (network.isNull()) {
+        network = createNetworkEntry(service, info);
+        _scanResults.setEntry(info.path, network);
+    }
+
+    return network;
+}
+
+bool WifiNetworkService::parseNetworkListOptions(const RequestParser& parser, NetworkListOptions& options,
+                                                 QString& errorText)
+{
+    QString sortBy;
+
+    if (parser.has(FINDNETWORKS_SORT_BY)) {
+        sortBy = parser.stringValue(FINDNETWORKS_SORT_BY);
+
+        if (sortBy == "signal")
+            options.sortBy = NetworkListOptions::SORT_SIGNAL;
+        else if (sortBy == "name")
+            options.sortBy = NetworkListOptions::SORT_NAME;
+        else if (sortBy == "profile-first")
+            options.sortBy = NetworkListOptions::SORT_PROFILE_FIRST;
+        else {
+            errorText = "Invalid value for parameter sortBy";
+            return false;
+        }
+    }
+
+    if (parser.has(FINDNETWORKS_LIMIT)) {
+        options.limit = parser.intValue(FINDNETWORKS_LIMIT);
+        if (options.limit < 0) {
+            errorText = "Invalid value for parameter limit";
+            return false;
+        }
+    }
+
+    if (parser.has(FINDNETWORKS_OFFSET)) {
+        options.offset = parser.intValue(FINDNETWORKS_OFFSET);
+        if (options.offset < 0) {
+            errorText = "Invalid value for parameter offset";
+            return false;
+        }
+    }
+
+    if (parser.has(FINDNETWORKS_MIN_SIGNAL_LEVEL)) {
+        if (parser.intValue(FINDNETWORKS_MIN_SIGNAL_LEVEL) < 0) {
+            errorText = "Invalid value for parameter minSignalLevel";
+            return false;
+        }
+        options.minSignalLevel = parser.intValue(FINDNETWORKS_MIN_SIGNAL_LEVEL);
+    }
+
+    return true;
+}
+
+/* A network which made it through the minSignalLevel filter; the position in connman's
+ * list breaks ties so every sort order is deterministic */
+struct NetworkCandidate {
+    NetworkService *service;
+    const ConnmanServiceInfo *info;
+    int index;
+    bool hasProfile;
+};
+
+class NetworkCandidateLess
+{
+public:
+    NetworkCandidateLess(NetworkListOptions::SortBy sortBy) : _sortBy(sortBy) { }
+
+    bool operator()(const NetworkCandidate& a, const NetworkCandidate& b) const
+    {
+        int result;
+
+        switch (_sortBy) {
+        case NetworkListOptions::SORT_SIGNAL:
+            if (a.info->strength != b.info->strength)
+                return a.info->strength > b.info->strength;
+            break;
+        case NetworkListOptions::SORT_NAME:
+            result = QString::compare(a.info->name, b.info->name, Qt::CaseInsensitive);
+            if (result != 0)
+                return result < 0;
+            break;
+        case NetworkListOptions::SORT_PROFILE_FIRST:
+            /* networks we have a profile for first, each part by signal */
+            if (a.hasProfile != b.hasProfile)
+                return a.hasProfile;
+            if (a.info->strength != b.info->strength)
+                return a.info->strength > b.info->strength;
+            break;
+        default:
+            break;
+        }
+
+        return a.index < b.index;
+    }
+
+private:
+    NetworkListOptions::SortBy _sortBy;
+};
+
+void WifiNetworkService::appendFoundNetworksToMessage(JsonWriter& message, const NetworkListOptions& options)
+{
+    std::vector<NetworkCandidate> candidates;
+    NetworkCandidate candidate;
+    unsigned int first;
+    unsigned int last;
+    unsigned int n;
+
+    candidates.reserve(this->listNetworks().size());
+
+    foreach(NetworkService *service, this->listNetworks()) {
+        const ConnmanServiceInfo *info = _serviceTable.find(service);
+
+        /* Don't process hidden networks */
+        if (info == NULL || info->name.isEmpty() || info->strength < options.minSignalLevel)
+            continue;
+
+        candidate.service = service;
+        candidate.info = info;
+        candidate.index = candidates.size();
+        candidate.hasProfile = options.sortBy == NetworkListOptions::SORT_PROFILE_FIRST &&
+            (info->favorite || _profiles.findProfileByDBusPath(info->path) != NULL);
+        candidates.push_back(candidate);
+    }
+
+    first = std::min((unsigned int) options.offset, (unsigned int) candidates.size());
+    last = candidates.size();
+    if (options.limit >= 0 && (unsigned int) options.limit < last - first)
+        last = first + options.limit;
+
+    /* Only the networks up to the end of the requested page need to be in order which
+     * is a lot cheaper than sorting all of them when just the top few are wanted */
+    if (options.sortBy != NetworkListOptions::SORT_NONE) {
+        NetworkCandidateLess less(options.sortBy);
+
+        if (last < candidates.size())
+            std::partial_sort(candidates.begin(), candidates.begin() + last, candidates.end(), less);
+        else
+            std::sort(candidates.begin(), candidates.end(), less);
+    }
+
+    message.key("foundNetworks").beginArray();
+
+    for (n = first; n < last; n++)
+        message.raw(networkEntry(candidates[n].service, *candidates[n].info));
+
+    message.endArray();
+
+    if (options.limit >= 0 || options.offset > 0)
+        message.member("totalNetworks", (unsigned int) candidates.size());
+}
+
+void WifiNetworkService::scanResultChanged()
+{
+    NetworkService *service = qobject_cast<NetworkService*>(sender());
+    const ConnmanServiceInfo *info = _serviceTable.find(service);
+
+    _metrics.countSignal(AdapterMetrics::SIGNAL_SERVICE_CHANGED);
+
+    if (info == NULL)
+        return;
+
+    _scanResults.invalidate(info->path);
+
+    if (service == _currentService)
+        markStatusChanged();
+
+    if (_networkSubscribers > 0)
+        scheduleNetworkChanges();
+}
+
+void WifiNetworkService::wifiScanFinished()
+{
+    LSError lserror;
+    QByteArray payload;
+
+    _metrics.countSignal(AdapterMetrics::SIGNAL_SCAN_FINISHED);
+    _trace.instant("scanFinished");
+
+    LSErrorInit(&lserror);
+
+    if (this->listNetworks().length() == 0 && _scanRetry < 3) {
+        _wifiTechnology->requestScan();
+        _scanRetry++;
+        return;
+    }
+
+    _scanResults.markScanCompleted();
+    _metrics.scanFinished();
+
+    /* Every caller which was waiting for this scan without any options gets the very
+     * same payload; the others get the list the way they asked for it */
+    foreach (const ScanRequest& scanRequest, _scanRequests) {
+        const LunaServiceRequestData& request = scanRequest.request;
+        const char *data;
+
+        if (scanRequest.options.isDefault() && !payload.isNull()) {
+            data = payload.constData();
+        }
+        else {
+            JsonWriter& response = beginResponse();
+
+            response.beginObject();
+            appendFoundNetworksToMessage(response, scanRequest.options);
+            response.member("returnValue", true);
+            response.endObject();
+
+            data = response.data();
+
+            /* Deep copy as the writer's buffer gets reused for the next message */
+            if (scanRequest.options.isDefault()) {
+                payload = response.toByteArray();
+                data = payload.constData();
+            }
+        }
+
+        if (!LSMessageReply(request.handle, request.message, data, &lserror)) {
             LSErrorPrint(&lserror, stderr);
             LSErrorFree(&lserror);
         }
 
-        json_object_put(_connectServiceRequest.response);
+        LSMessageUnref(request.message);
+    }
+
+    _scanRequests.clear();
+    _scanInProgress = false;
+
+    disconnect(_wifiTechnology, SIGNAL(scanFinished()), this, SLOT(wifiScanFinished()));
+
+    /* Subscribers learn about everything the scan found before they are told it's done */
+    if (_networkSubscribers > 0) {
+        postNetworkChanges();
+
+        JsonWriter& marker = beginResponse();
+
+        marker.beginObject();
+        marker.member("scanComplete", true);
+        marker.member("returnValue", true);
+        marker.endObject();
+
+        postToNetworksSubscribers(marker.data(), marker.length());
+    }
+}
+
+void WifiNetworkService::addNetworksSubscriber(LSHandle *handle, LSMessage *message)
+{
+    LSError lserror;
+    bool subscribed;
+
+    LSErrorInit(&lserror);
+
+    subscribed = LSSubscriptionAdd(handle, "findnetworks", message, &lserror);
+    if (!subscribed) {
+        LSErrorPrint(&lserror, stderr);
+        LSErrorFree(&lserror);
     }
-}
 
-json_object* WifiNetworkService::createMessageFromProfile(ServiceProfile *profile)
-{
-    NetworkService *service;
-    json_object *wifiProfile;
-    json_object *wifiProfileDetails;
-    json_object *security;
-    QString securityTypeValue = "none";
+    /* Whoever subscribed before has to be up to date before we take the list we're
+     * sending now as what all subscribers know */
+    if (_networkSubscribers > 0)
+        postNetworkChanges();
+
+    JsonWriter& response = beginResponse();
 
-    service = profile->service();
-    wifiProfile = json_object_new_object();
+    response.beginObject();
+    response.member("subscribed", subscribed);
+    appendFoundNetworksToMessage(response);
+    response.member("returnValue", true);
+    response.endObject();
 
-    wifiProfileDetails = json_object_new_object();
-    json_object_object_add(wifiProfile, "wifiProfile", wifiProfileDetails);
+    if (!LSMessageReply(handle, message, response.data(), &lserror)) {
+        LSErrorPrint(&lserror, stderr);
+        LSErrorFree(&lserror);
+    }
 
-    json_object_object_add(wifiProfileDetails, "ssid",
-        json_object_new_string(service->name().toUtf8().constData()));
-    json_object_object_add(wifiProfileDetails, "profileId", json_object_new_int(profile->id()));
+    if (!subscribed)
+        return;
 
-    if (!service->security().isEmpty()) {
-        security = json_object_new_object();
-        securityTypeValue = service->security().first();
+    if (_networkSubscribers == 0) {
+        _streamedNetworks.clear();
 
-        json_object_object_add(security, "securityType",
-            json_object_new_string(convert_connman_security_type_to_palm(securityTypeValue.toUtf8().constData())));
+        foreach (NetworkService *service, listNetworks()) {
+            const ConnmanServiceInfo *info = _serviceTable.find(service);
 
-        json_object_object_add(wifiProfileDetails, "security", security);
+            if (info != NULL && !info->name.isEmpty())
+                _streamedNetworks.insert(info->path, info->name);
+        }
     }
 
-    /* NOTE: we're not supporting the simpleSecurity/enterpriseSecurity element */
-    /* NOTE: we're not supporting the RoamingHistogram element */
+    _networkSubscribers++;
 
-    return wifiProfile;
+    if (!_scanInProgress)
+        startScan();
 }
 
-void WifiNetworkService::appendProfileListToMessage(json_object *message)
+void WifiNetworkService::scheduleNetworkChanges()
 {
-    json_object *profileList;
-    json_object *wifiProfile;
+    /* Everything changing within one main loop iteration goes into a single post */
+    if (_networkChangesIdle == 0)
+        _networkChangesIdle = g_idle_add(cbNetworkChanges, this);
+}
 
-    profileList = json_object_new_array();
+gboolean WifiNetworkService::cbNetworkChanges(gpointer user_data)
+{
+    WifiNetworkService *self = (WifiNetworkService*) user_data;
 
-    foreach(ServiceProfile* profile, _profiles.list()) {
-        wifiProfile = createMessageFromProfile(profile);
-        json_object_array_add(profileList, wifiProfile);
-    }
+    self->_networkChangesIdle = 0;
+    self->postNetworkChanges();
 
-    json_object_object_add(message, "profileList", profileList);
+    return FALSE;
 }
 
-bool WifiNetworkService::processGetStatusMethod(LSHandle *handle, LSMessage *message)
+/* Tells findnetworks subscribers which networks appeared, changed or disappeared since
+ * the last post. A network changed when its cached entry was dropped. */
+void WifiNetworkService::postNetworkChanges()
 {
-    json_object *response;
-    LSError lserror;
-    bool subscribed = false;
-    bool success = false;
-    QString state;
+    QHash<QString, QString> current;
+    QList<NetworkService*> added;
+    QList<NetworkService*> changed;
+    QStringList removed;
+    QHash<QString, QString>::const_iterator it;
+
+    if (_networkChangesIdle != 0) {
+        g_source_remove(_networkChangesIdle);
+        _networkChangesIdle = 0;
+    }
 
-    LSErrorInit(&lserror);
+    if (_networkSubscribers == 0)
+        return;
 
-    response = json_object_new_object();
+    foreach (NetworkService *service, listNetworks()) {
+        const ConnmanServiceInfo *info = _serviceTable.find(service);
 
-    if (LSMessageIsSubscription(message)) {
-        if (!LSSubscriptionProcess(handle, message, &subscribed, &lserror)) {
-            LSErrorPrint(&lserror, stderr);
-            LSErrorFree(&lserror);
-        }
+        /* Hidden networks are left out just like in the full list */
+        if (info == NULL || info->name.isEmpty())
+            continue;
+
+        current.insert(info->path, info->name);
 
-        json_object_object_add(response, "subscribed", json_object_new_boolean(subscribed));
+        if (!_streamedNetworks.contains(info->path))
+            added.append(service);
+        else if (_scanResults.entry(info->path).isNull() ||
+                 _streamedNetworks.value(info->path) != info->name)
+            changed.append(service);
     }
 
-    if (!checkForConnmanService(response))
-        goto done;
+    for (it = _streamedNetworks.constBegin(); it != _streamedNetworks.constEnd(); ++it) {
+        if (!current.contains(it.key()))
+            removed.append(it.value());
+    }
 
-    json_object_object_add(response, "wakeOnWlan", json_object_new_string("disabled"));
-    json_object_object_add(response, "status",
-        json_object_new_string(isWifiPowered() ? "serviceEnabled" : "serviceDisabled"));
+    _streamedNetworks = current;
 
-    if (isWifiPowered() && _currentService != NULL) {
-        state = convert_connman_service_state_to_palm(_stateOfCurrentService, _stateOfCurrentService);
-        appendConnectionStatusToMessage(response, _currentService, state);
-    }
+    if (added.isEmpty() && changed.isEmpty() && removed.isEmpty())
+        return;
 
-    success = true;
+    JsonWriter& response = beginResponse();
 
-done:
-    json_object_object_add(response, "returnValue", json_object_new_boolean(success));
+    response.beginObject();
 
-    if (!LSMessageReply(handle, message, json_object_to_json_string(response), &lserror)) {
-        LSErrorPrint(&lserror, stderr);
-        LSErrorFree(&lserror);
+    if (!added.isEmpty()) {
+        response.key("added").beginArray();
+        foreach (NetworkService *service, added)
+            response.raw(networkEntry(service, *_serviceTable.find(service)));
+        response.endArray();
     }
 
-    json_object_put(response);
+    if (!changed.isEmpty()) {
+        response.key("changed").beginArray();
+        foreach (NetworkService *service, changed)
+            response.raw(networkEntry(service, *_serviceTable.find(service)));
+        response.endArray();
+    }
 
-    return true;
+    if (!removed.isEmpty()) {
+        response.key("removed").beginArray();
+        foreach (const QString& name, removed)
+            response.value(name);
+        response.endArray();
+    }
+
+    response.member("returnValue", true);
+    response.endObject();
+
+    postToNetworksSubscribers(response.data(), response.length());
 }
 
-bool WifiNetworkService::processSetStateMethod(LSHandle *handle, LSMessage *message)
+void WifiNetworkService::postToNetworksSubscribers(const char *payload, int length)
 {
-    json_object *response;
-    json_object *root;
-    json_object *state;
-    QString stateValue;
     LSError lserror;
-    bool success = false;
 
     LSErrorInit(&lserror);
 
-    const char* str = LSMessageGetPayload(message);
-    if( !str )
-        return false;
+    _metrics.countPost(length);
+    _trace.instant("subscriptionPost", length);
 
-    response = json_object_new_object();
+    if (!LSSubscriptionReply(_privateService, "findnetworks", payload, &lserror)) {
+        LSErrorPrint(&lserror, stderr);
+        LSErrorFree(&lserror);
+    }
+}
 
-    if (!checkForConnmanService(response))
-        goto done;
+void WifiNetworkService::startScan()
+{
+    _scanInProgress = true;
+    _scanRetry = 0;
 
-    root = json_tokener_parse(str);
-    if (!root || is_error(root)) {
-        root = 0;
-        json_object_object_add(response, "errorText", json_object_new_string("InvalidRequest"));
-        goto done;
-    }
+    _metrics.scanStarted();
 
-    state = json_object_object_get(root, "state");
-    stateValue = json_object_get_string(state);
+    connect(_wifiTechnology, SIGNAL(scanFinished()), this, SLOT(wifiScanFinished()));
+    _wifiTechnology->requestScan();
+}
 
-    if (stateValue.isEmpty() || (stateValue != "enabled" && stateValue != "disabled")) {
-        json_object_object_add(response, "errorCode", json_object_new_int(1));
-        json_object_object_add(response, "errorText", json_object_new_string("InvalidStateValue"));
-        goto done;
-    }
+void WifiNetworkService::cancelPendingScans()
+{
+    LSError lserror;
 
-    if (stateValue == "enabled" && isWifiPowered()) {
-        json_object_object_add(response, "errorCode", json_object_new_int(15));
-        json_object_object_add(response, "errorText", json_object_new_string("AlreadyEnabled"));
-        goto done;
-    }
-    else if (stateValue == "disabled" && !isWifiPowered()) {
-        success = true;
-        goto done;
-    }
+    LSErrorInit(&lserror);
 
-    setWifiPowered(stateValue == "enabled" ? true : false);
+    if (_scanRequests.isEmpty())
+        return;
 
-    success = true;
+    JsonWriter& response = beginResponse();
 
-done:
-    if (root)
-        json_object_put(root);
+    response.beginObject();
+    response.member("errorCode", 12);
+    response.member("errorText", "NotPermitted");
+    response.member("returnValue", false);
+    response.endObject();
 
-    json_object_object_add(response, "returnValue", json_object_new_boolean(success));
+    foreach (const ScanRequest& scanRequest, _scanRequests) {
+        _metrics.countError("FindNetworks");
+
+        if (!LSMessageReply(scanRequest.request.handle, scanRequest.request.message,
+                            response.data(), &lserror)) {
+            LSErrorPrint(&lserror, stderr);
+            LSErrorFree(&lserror);
+        }
 
-    LSMessageReply(handle, message, json_object_to_json_string(response), &lserror);
+        LSMessageUnref(scanRequest.request.message);
+    }
 
-    json_object_put(response);
+    _scanRequests.clear();
+    _scanInProgress = false;
 
-    return true;
+    if (_wifiTechnology)
+        disconnect(_wifiTechnology, SIGNAL(scanFinished()), this, SLOT(wifiScanFinished()));
 }
 
-void WifiNetworkService::wifiScanFinished()
+bool WifiNetworkService::processFindNetworksMethod(LSHandle *handle, LSMessage *message)
 {
-    json_object *response;
-    json_object *foundNetworks;
-    json_object *network;
-    json_object *networkInfo;
+    RequestParser parser(_findNetworksFields, FIELD_COUNT(_findNetworksFields));
+    ScanRequest scanRequest;
     LSError lserror;
+    int maxAgeValue = -1;
+    QString errorText;
+    int field;
 
-    if (this->listNetworks().length() == 0 && _scanRetry < 3) {
-        _wifiTechnology->requestScan();
-        _scanRetry++;
-        return;
-    }
-
-    response = json_object_new_object();
-
-    foundNetworks = json_object_new_array();
-    foreach(NetworkService *service, this->listNetworks()) {
-        QString connectState = "";
-        char *security = NULL;
-        QString securityTypeValue = "none";
-        ServiceProfile *profile = NULL;
-
-        network = json_object_new_object();
-        networkInfo = json_object_new_object();
-
-        if (service->name().length() == 0) {
-            /* Don't process hidden networks */
-            json_object_put(network);
-            json_object_put(networkInfo);
-            continue;
-        }
+    LSErrorInit(&lserror);
 
-        profile = _profiles.findProfileByDBusPath(service->dbusPath());
-        if (profile != NULL) {
-            json_object_object_add(networkInfo, "profileId", json_object_new_int(profile->id()));
-        }
-        else if (service->favorite()) {
-            profile = _profiles.createProfile(service);
-            qDebug() << "New profile: service = " << profile->dbusPath() << " id = " << profile->id();
+    if (!_manager->isAvailable() || !isWifiPowered()) {
+        JsonWriter& response = beginResponse();
 
-            json_object_object_add(networkInfo, "profileId", json_object_new_int(profile->id()));
-        }
+        response.beginObject();
+        response.member("errorCode", 12);
+        response.member("errorText", "NotPermitted");
+        response.member("returnValue", false);
+        response.endObject();
 
-        /* default values needed for each entry */
-        json_object_object_add(networkInfo, "ssid",
-            json_object_new_string(service->name().toUtf8().constData()));
+        _metrics.countError("FindNetworks");
 
-        if (!service->security().isEmpty()) {
-            securityTypeValue = service->security().first();
+        if (!LSMessageReply(handle, message, response.data(), &lserror)) {
+            LSErrorPrint(&lserror, stderr);
+            LSErrorFree(&lserror);
         }
 
-        security = convert_connman_security_type_to_palm(securityTypeValue.toUtf8().constData());
-        if (security) {
-            json_object_object_add(networkInfo, "securityType", json_object_new_string(security));
-        }
+        return true;
+    }
 
-        /* We only get a normalized value for the signal strength in range of 0-100 from
-         * connman so we have to convert it here to map it to com.palm.wifi API */
-        json_object_object_add(networkInfo, "signalBars",
-            json_object_new_int((service->strength() * MAX_SIGNAL_BARS) / 100));
-        json_object_object_add(networkInfo, "signalLevel", json_object_new_int(service->strength()));
-
-        if (service->state() == "failure")
-            /* FIXME we can't differ between "ipFailed" and "associationFailed" here; need
-             * to track service state somehow. */
-            connectState = "ipFailed";
-        else if (service->state() == "association")
-            connectState = "associating";
-        else if (service->state() == "online")
-            connectState = "ipConfigured";
-
-        if (!connectState.isEmpty()) {
-            json_object_object_add(networkInfo, "connectState",
-                json_object_new_string(connectState.toUtf8().constData()));
+    /* All parameters are optional so a payload which isn't JSON at all simply triggers
+     * a scan; a parameter with a value of the wrong type is reported though */
+    if (!parser.parse(LSMessageGetPayload(message))) {
+        if (!parser.isMalformed())
+            errorText = parser.errorText();
+    }
+    else if (LSMessageIsSubscription(message)) {
+        /* Subscribers get posts with only what changed since the last one, which can't
+         * be sorted, filtered or paged like a full list */
+        for (field = 0; field < FIELD_COUNT(_findNetworksFields); field++) {
+            if (parser.has(field)) {
+                errorText = QString("Parameter %1 is not supported with subscribe")
+                            .arg(_findNetworksFields[field].path);
+                break;
+            }
         }
+    }
+    else {
+        if (parser.has(FINDNETWORKS_MAX_AGE))
+            maxAgeValue = parser.intValue(FINDNETWORKS_MAX_AGE);
 
-        json_object_object_add(network, "networkInfo", networkInfo);
-        json_object_array_add(foundNetworks, network);
+        parseNetworkListOptions(parser, scanRequest.options, errorText);
     }
 
-    json_object_object_add(response, "foundNetworks", foundNetworks);
-    json_object_object_add(response, "returnValue", json_object_new_boolean(true));
+    if (!errorText.isEmpty()) {
+        JsonWriter& response = beginResponse();
 
-    if (!LSMessageReply(_scanServiceRequest.handle, _scanServiceRequest.message, json_object_to_json_string(response), &lserror)) {
-        LSErrorPrint(&lserror, stderr);
-        LSErrorFree(&lserror);
-    }
+        response.beginObject();
+        if (LSMessageIsSubscription(message))
+            response.member("subscribed", false);
+        response.member("errorText", errorText);
+        response.member("returnValue", false);
+        response.endObject();
 
-    json_object_put(response);
+        _metrics.countError("FindNetworks");
 
-    disconnect(_wifiTechnology, SIGNAL(scanFinished()), this, SLOT(wifiScanFinished()));
-}
+        if (!LSMessageReply(handle, message, response.data(), &lserror)) {
+            LSErrorPrint(&lserror, stderr);
+            LSErrorFree(&lserror);
+        }
 
-bool WifiNetworkService::processFindNetworksMethod(LSHandle *handle, LSMessage *message)
-{
-    json_object *response;
-    json_object *foundNetworks;
-    json_object *network;
-    json_object *networkInfo;
-    LSError lserror;
-    bool success = false;
+        return true;
+    }
 
-    LSErrorInit(&lserror);
+    /* Subscribers get what we know right away and then every change of it */
+    if (LSMessageIsSubscription(message)) {
+        /* The subscription holds its own reference */
+        addNetworksSubscriber(handle, message);
+        return true;
+    }
 
-    if (!checkForConnmanService(response) || !isWifiPowered()) {
-        response = json_object_new_object();
+    /* Callers which can live with results of a recent scan get them right away */
+    if (_scanResults.isFresh(maxAgeValue)) {
+        JsonWriter& response = beginResponse();
 
-        json_object_object_add(response, "errorCode", json_object_new_int(12));
-        json_object_object_add(response, "errorText", json_object_new_string("NotPermitted"));
-        json_object_object_add(response, "returnValue", json_object_new_boolean(false));
+        response.beginObject();
+        appendFoundNetworksToMessage(response, scanRequest.options);
+        response.member("returnValue", true);
+        response.endObject();
 
-        if (!LSMessageReply(handle, message, json_object_to_json_string(response), &lserror)) {
+        if (!LSMessageReply(handle, message, response.data(), &lserror)) {
             LSErrorPrint(&lserror, stderr);
             LSErrorFree(&lserror);
         }
 
-        json_object_put(response);
-
         return true;
     }
 
-    _scanServiceRequest.reset();
-    _scanServiceRequest.handle = handle;
-    _scanServiceRequest.message = message;
+    /* Released once the scan is finished or canceled */
+    LSMessageRef(message);
 
-    _scanRetry = 0;
+    scanRequest.request.handle = handle;
+    scanRequest.request.message = message;
+    scanRequest.request.valid = true;
+    _scanRequests.append(scanRequest);
 
-    connect(_wifiTechnology, SIGNAL(scanFinished()), this, SLOT(wifiScanFinished()));
-    _wifiTechnology->requestScan();
+    /* A caller arriving while a scan is already running is attached to it instead of
+     * issuing another one; all waiters are answered at once from wifiScanFinished */
+    if (!_scanInProgress)
+        startScan();
 
     return true;
 }
 
 bool WifiNetworkService::processConnectMethod(LSHandle *handle, LSMessage *message)
 {
-    json_object *response;
-    json_object *request;
-    json_object *profileId;
-    json_object *ssid;
-    json_object *securityType;
-    QString ssidValue;
-    QString securityTypeValue;
+    RequestParser request(_connectFields, FIELD_COUNT(_connectFields));
+    QString errorText;
     LSError lserror;
     const char *payload;
     bool success = false;
-    int profileIdValue;
 
     LSErrorInit(&lserror);
 
-    response = json_object_new_object();
+    JsonWriter& response = beginResponse();
+
+    response.beginObject();
 
     if (!checkForConnmanService(response))
         goto done;
@@ -901,78 +2004,68 @@ bool WifiNetworkService::processConnectMethod(LSHandle *handle, LSMessage *messa
     if( !payload )
         return false;
 
-    request = json_tokener_parse(payload);
-    if (!request || is_error(request)) {
-        request = 0;
-        json_object_object_add(response, "errorText", json_object_new_string("InvalidRequest"));
+    if (!request.parse(payload)) {
+        errorText = request.errorText();
         goto done;
     }
 
-    profileId = json_object_object_get(request, "profileId");
-    ssid = json_object_object_get(request, "ssid");
-
-    if (profileId && ssid) {
-        json_object_object_add(response, "errorText", json_object_new_string("Only profileId OR ssid as parameter is allowed"));
+    if (request.has(CONNECT_PROFILE_ID) && request.has(CONNECT_SSID)) {
+        errorText = "Only profileId OR ssid as parameter is allowed";
         goto done;
     }
-    else if (profileId && securityType) {
-        json_object_object_add(response, "errorText", json_object_new_string("Parameter securityType is not allowed when profileId is specified"));
+    else if (request.has(CONNECT_PROFILE_ID) && request.has(CONNECT_SECURITY_TYPE)) {
+        errorText = "Parameter securityType is not allowed when profileId is specified";
         goto done;
     }
 
-    if (profileId) {
-        profileIdValue = json_object_get_int(profileId);
+    if (request.has(CONNECT_PROFILE_ID)) {
         qDebug() << "Connecting with profile id ...";
-        success = connectWithProfileId(profileIdValue, response);
+        success = connectWithProfileId(request.intValue(CONNECT_PROFILE_ID), errorText);
     }
-    else if (ssid) {
-        ssidValue = json_object_get_string(ssid);
+    else if (request.has(CONNECT_SSID)) {
         qDebug() << "Connecting with ssid ...";
-        success = connectWithSsid(ssidValue, request, response);
+        success = connectWithSsid(request.stringValue(CONNECT_SSID), request, errorText);
     }
 
 done:
     if (!success) {
-        json_object_object_add(response, "returnValue", json_object_new_boolean(success));
+        _metrics.countError("Connect");
+
+        if (!errorText.isEmpty())
+            response.member("errorText", errorText);
 
-        if (!LSMessageReply(handle, message, json_object_to_json_string(response), &lserror)) {
+        response.member("returnValue", success);
+        response.endObject();
+
+        if (!LSMessageReply(handle, message, response.data(), &lserror)) {
             LSErrorPrint(&lserror, stderr);
             LSErrorFree(&lserror);
         }
-
-        json_object_put(response);
     }
     else {
-        _connectServiceRequest.reset();
-        _connectServiceRequest.handle = handle;
-        _connectServiceRequest.message = message;
-        _connectServiceRequest.response = response;
-        _connectServiceRequest.valid = true;
-
-        /* FIXME issue a short timeout to be sure our client gets a response */
+        /* The reply is sent once connman tells us how the connect went; the queue
+         * releases the reference then */
+        LSMessageRef(message);
+        _connectRequests.enqueue(handle, message, _currentService->dbusPath());
+        _connectTimings.start(_currentService->dbusPath());
     }
 
-    if (request)
-        json_object_put(request);
-
     return true;
 }
 
 bool WifiNetworkService::processGetProfileMethod(LSHandle *handle, LSMessage *message)
 {
-    json_object *response;
-    json_object *request;
-    json_object *profileId;
-    json_object *wifiProfile;
+    RequestParser request(_profileFields, FIELD_COUNT(_profileFields));
     LSError lserror;
     bool success = false;
     const char *payload;
-    int id;
     ServiceProfile *requestedProfile = NULL;
 
     LSErrorInit(&lserror);
 
-    response = json_object_new_object();
+    JsonWriter& response = beginResponse();
+
+    response.beginObject();
 
     if (!checkForConnmanService(response))
         goto done;
@@ -981,31 +2074,21 @@ bool WifiNetworkService::processGetProfileMethod(LSHandle *handle, LSMessage *me
     if( !payload )
         return false;
 
-    request = json_tokener_parse(payload);
-    if (!request || is_error(request)) {
-        request = 0;
-        json_object_object_add(response, "errorText", json_object_new_string("InvalidRequest"));
+    if (!request.parse(payload)) {
+        response.member("errorText", request.errorText());
         goto done;
     }
 
-    profileId = json_object_object_get(request, "profileId");
-    if (profileId) {
-        id = json_object_get_int(profileId);
-
-        foreach (ServiceProfile *profile, _profiles.list()) {
-            if (profile->id() == id) {
-                requestedProfile = profile;
-                break;
-            }
-        }
+    if (request.has(PROFILE_PROFILE_ID)) {
+        requestedProfile = _profiles.findProfileById(request.intValue(PROFILE_PROFILE_ID));
 
         if (requestedProfile == NULL) {
-            json_object_object_add(response, "errorText", json_object_new_string("No profile available for provided id"));
+            response.member("errorText", "No profile available for provided id");
             goto done;
         }
 
-        wifiProfile = createMessageFromProfile(requestedProfile);
-        json_object_object_add(response, "wifiProfile", wifiProfile);
+        response.key("wifiProfile");
+        appendProfileToMessage(response, requestedProfile);
     }
     else {
         appendProfileListToMessage(response);
@@ -1014,66 +2097,65 @@ bool WifiNetworkService::processGetProfileMethod(LSHandle *handle, LSMessage *me
     success = true;
 
 done:
-    json_object_object_add(response, "returnValue", json_object_new_boolean(success));
+    if (!success)
+        _metrics.countError("GetProfile");
 
-    if (!LSMessageReply(handle, message, json_object_to_json_string(response), &lserror)) {
+    response.member("returnValue", success);
+    response.endObject();
+
+    if (!LSMessageReply(handle, message, response.data(), &lserror)) {
         LSErrorPrint(&lserror, stderr);
         LSErrorFree(&lserror);
     }
 
-    json_object_put(response);
-
-    if (request != NULL)
-        json_object_put(request);
-
     return true;
 }
 
 bool WifiNetworkService::processGetInfoMethod(LSHandle *handle, LSMessage *message)
 {
-    json_object *response;
-    json_object *wifiinfo;
     LSError lserror;
     bool success = false;
 
     LSErrorInit(&lserror);
 
-    response = json_object_new_object();
+    JsonWriter& response = beginResponse();
+
+    response.beginObject();
 
     if (!checkForConnmanService(response))
         goto done;
 
-    wifiinfo = json_object_new_object();
+    response.key("wifiInfo").beginObject();
 
     /* default values until we have something real */
-    json_object_object_add(wifiinfo, "macAddress", json_object_new_string("ff:ff:ff:ff:ff:ff"));
-    json_object_object_add(wifiinfo, "wakeOnWlan", json_object_new_string("disabled"));
-    json_object_object_add(wifiinfo, "wmm", json_object_new_string("disabled"));
-    json_object_object_add(wifiinfo, "roaming", json_object_new_string("disabled"));
-    json_object_object_add(wifiinfo, "powerSave", json_object_new_string("enabled"));
+    response.member("macAddress", "ff:ff:ff:ff:ff:ff");
+    response.member("wakeOnWlan", "disabled");
+    response.member("wmm", "disabled");
+    response.member("roaming", "disabled");
+    response.member("powerSave", "enabled");
 
-    json_object_object_add(response, "wifiInfo", wifiinfo);
+    response.endObject();
 
     success = true;
 
 done:
-    json_object_object_add(response, "returnValue", json_object_new_boolean(success));
+    if (!success)
+        _metrics.countError("GetInfo");
 
-    if (!LSMessageReply(handle, message, json_object_to_json_string(response), &lserror)) {
+    response.member("returnValue", success);
+    response.endObject();
+
+    if (!LSMessageReply(handle, message, response.data(), &lserror)) {
         LSErrorPrint(&lserror, stderr);
         LSErrorFree(&lserror);
     }
 
-    json_object_put(response);
-
     return true;
 }
 
 bool WifiNetworkService::processDeleteProfileMethod(LSHandle *handle, LSMessage *message)
 {
-    json_object *response;
-    json_object *request;
-    json_object *profileId;
+    RequestParser request(_profileFields, FIELD_COUNT(_profileFields));
     LSError lserror;
     bool success = false;
     const char *payload;
@@ -1082,7 +2164,9 @@ bool WifiNetworkService::processDeleteProfileMethod(LSHandle *handle, LSMessage
 
     LSErrorInit(&lserror);
 
-    response = json_object_new_object();
+    JsonWriter& response = beginResponse();
+
+    response.beginObject();
 
     if (!checkForConnmanService(response))
         goto done;
@@ -1091,24 +2175,25 @@ bool WifiNetworkService::processDeleteProfileMethod(LSHandle *handle, LSMessage
     if( !payload )
         return false;
 
-    request = json_tokener_parse(payload);
-    if (!request || is_error(request)) {
-        request = 0;
-        json_object_object_add(response, "errorText", json_object_new_string("InvalidRequest"));
+    if (!request.parse(payload)) {
+        response.member("errorText", request.errorText());
         goto done;
     }
 
-    profileId = json_object_object_get(request, "profileId");
-    if (!profileId) {
-        json_object_object_add(response, "errorText", json_object_new_string("Missing argument: profileId"));
+    if (!request.has(PROFILE_PROFILE_ID)) {
+        response.member("errorText", "Missing argument: profileId");
         goto done;
     }
 
-    id = json_object_get_int(profileId);
+    id = request.intValue(PROFILE_PROFILE_ID);
     profile = _profiles.findProfileById(id);
     if (profile != NULL) {
-        profile->service()->requestRemove();
+        /* Connman only knows about services which are in range */
+        if (profile->service() != NULL)
+            profile->service()->requestRemove();
+        _scanResults.invalidate(profile->dbusPath());
         _profiles.removeProfileById(id);
+        markStatusChanged();
     }
 
     success = true;
@@ -1117,30 +2202,30 @@ bool WifiNetworkService::processDeleteProfileMethod(LSHandle *handle, LSMessage
      * corresponding update signals */
 
 done:
-    json_object_object_add(response, "returnValue", json_object_new_boolean(success));
+    if (!success)
+        _metrics.countError("DeleteProfile");
+
+    response.member("returnValue", success);
+    response.endObject();
 
-    if (LSMessageReply(handle, message, json_object_to_json_string(response), &lserror)) {
+    if (!LSMessageReply(handle, message, response.data(), &lserror)) {
         LSErrorPrint(&lserror, stderr);
         LSErrorFree(&lserror);
     }
 
-    json_object_put(response);
-
-    if (request != NULL)
-        json_object_put(request);
-
     return true;
 }
 
 bool WifiNetworkService::processGetProfileListMethod(LSHandle *handle, LSMessage *message)
 {
-    json_object *response;
     LSError lserror;
     bool success = false;
 
     LSErrorInit(&lserror);
 
-    response = json_object_new_object();
+    JsonWriter& response = beginResponse();
+
+    response.beginObject();
 
     if (!checkForConnmanService(response))
         goto done;
@@ -1150,14 +2235,212 @@ bool WifiNetworkService::processGetProfileListMethod(LSHandle *handle, LSMessage
     success = true;
 
 done:
-    json_object_object_add(response, "returnValue", json_object_new_boolean(success));
+    if (!success)
+        _metrics.countError("GetProfileList");
+
+    response.member("returnValue", success);
+    response.endObject();
+
+    if (!LSMessageReply(handle, message, response.data(), &lserror)) {
+        LSErrorPrint(&lserror, stderr);
+        LSErrorFree(&lserror);
+    }
+
+    return true;
+}
+
+bool WifiNetworkService::processGetMetricsMethod(LSHandle *handle, LSMessage *message)
+{
+    LSError lserror;
+    int n;
+
+    LSErrorInit(&lserror);
+
+    JsonWriter& response = beginResponse();
+
+    response.beginObject();
+
+    _metrics.appendToMessage(response);
+
+    response.key("connectPhasesMs").beginObject();
+    for (n = 0; n < ConnectTimings::PHASE_COUNT; n++) {
+        response.key(ConnectTimings::phaseName(n));
+        AdapterMetrics::appendHistogramToMessage(response, _connectTimings.histogram(n));
+    }
+    response.endObject();
+
+    response.key("connectOutcomes").beginObject();
+    for (n = 0; n < ConnectTimings::OUTCOME_COUNT; n++)
+        response.member(ConnectTimings::outcomeName(n), _connectTimings.outcomeCount(n));
+    response.endObject();
+
+    response.key("subscribers").beginObject();
+    response.member("getstatus", _statusSubscriptions.count());
+    response.endObject();
+
+    response.member("returnValue", true);
+    response.endObject();
+
+    if (!LSMessageReply(handle, message, response.data(), &lserror)) {
+        LSErrorPrint(&lserror, stderr);
+        LSErrorFree(&lserror);
+    }
+
+    return true;
+}
+
+bool WifiNetworkService::processDumpTraceMethod(LSHandle *handle, LSMessage *message)
+{
+    LSError lserror;
+
+    LSErrorInit(&lserror);
+
+    JsonWriter& response = beginResponse();
+
+    response.beginObject();
+    _trace.appendToMessage(response);
+    response.member("returnValue", true);
+    response.endObject();
+
+    if (!LSMessageReply(handle, message, response.data(), &lserror)) {
+        LSErrorPrint(&lserror, stderr);
+        LSErrorFree(&lserror);
+    }
+
+    return true;
+}
+
+bool WifiNetworkService::processGetDiagnosticsMethod(LSHandle *handle, LSMessage *message)
+{
+    LSError lserror;
+    const ConnmanServiceInfo *info;
+    gint64 now = g_get_monotonic_time();
+    unsigned int n;
+
+    LSErrorInit(&lserror);
+
+    JsonWriter& response = beginResponse();
+
+    response.beginObject();
+    response.key("services").beginArray();
+
+    foreach (NetworkService *service, listNetworks()) {
+        info = _serviceTable.find(service);
+        if (info == NULL)
+            continue;
+
+        response.beginObject();
+        response.member("ssid", info->name);
+        response.member("path", info->path);
+        response.member("state", convert_connman_service_state_to_name(info->state));
+
+        response.key("history").beginArray();
+        for (n = 0; n < info->history.count(); n++) {
+            response.beginObject();
+            response.member("state", convert_connman_service_state_to_name(info->history.state(n)));
+            response.member("ageMs", (unsigned int) ((now - info->history.time(n)) / 1000));
+            response.endObject();
+        }
+        response.endArray();
+
+        response.member("joinAttempts", info->history.joinAttempts());
+        response.member("joinSuccesses", info->history.joinSuccesses());
+        response.member("averageTimeToOnlineMs", info->history.averageTimeToOnline());
+        response.endObject();
+    }
+
+    response.endArray();
+    response.member("returnValue", true);
+    response.endObject();
 
-    if (!LSMessageReply(handle, message, json_object_to_json_string(response), &lserror)) {
+    if (!LSMessageReply(handle, message, response.data(), &lserror)) {
         LSErrorPrint(&lserror, stderr);
         LSErrorFree(&lserror);
     }
 
-    json_object_put(response);
+    return true;
+}
+
+/* Every handler call is timed and traced here; the metrics of a method are kept under
+ * the name used for its callback. Consumes the reference the caller holds to the
+ * message. */
+bool WifiNetworkService::dispatchRequest(const char *name, MethodHandler handler,
+                                         LSHandle *handle, LSMessage *message)
+{
+    bool result;
+
+    _lastActivity = g_get_monotonic_time();
+
+    /* A plain status request can be answered with what we knew when we exited the last
+     * time as it's unlikely to have changed while nobody asked */
+    if (!_startupFinished && !_storedStatus.isEmpty() &&
+        handler == &WifiNetworkService::processGetStatusMethod &&
+        !LSMessageIsSubscription(message)) {
+        LSError lserror;
+
+        LSErrorInit(&lserror);
+
+        _trace.instant("storedStatusReply");
+
+        if (!LSMessageReply(handle, message, _storedStatus.constData(), &lserror)) {
+            LSErrorPrint(&lserror, stderr);
+            LSErrorFree(&lserror);
+        }
+
+        LSMessageUnref(message);
+        return true;
+    }
+
+    if (!_startupFinished) {
+        DeferredRequest request;
+
+        request.name = name;
+        request.handler = handler;
+        request.handle = handle;
+        request.message = message;
+
+        /* Keeps our reference until it's dispatched again once we're started */
+        _deferredRequests.append(request);
+
+        return true;
+    }
+
+    _trace.begin(name);
+    _metrics.beginCall(name);
+    result = (this->*handler)(handle, message);
+    _metrics.endCall();
+    _trace.end(name);
+
+    /* Handlers which keep the message around take their own reference */
+    LSMessageUnref(message);
+
+    return result;
+}
+
+bool WifiNetworkService::cbSubscriptionCanceled(LSHandle* lshandle, LSMessage *message, void *user_data)
+{
+    WifiNetworkService *self = (WifiNetworkService*) user_data;
+    const char *method = LSMessageGetMethod(message);
+    StatusSubscriptions::Filter filter;
+    QString errorText;
+
+    /* Only subscriptions with a valid filter were added in the first place */
+    if (method != NULL && !strcmp(method, "getstatus") &&
+        StatusSubscriptions::parseFilter(LSMessageGetPayload(message), filter, errorText))
+        self->_statusSubscriptions.remove(filter);
+
+    if (method != NULL && !strcmp(method, "findnetworks") && self->_networkSubscribers > 0) {
+        self->_networkSubscribers--;
+
+        if (self->_networkSubscribers == 0) {
+            self->_streamedNetworks.clear();
+
+            if (self->_networkChangesIdle != 0) {
+                g_source_remove(self->_networkChangesIdle);
+                self->_networkChangesIdle = 0;
+            }
+        }
+    }
 
     return true;
 }
@@ -1167,7 +2450,7 @@ bool WifiNetworkService::cb##name(LSHandle* lshandle, LSMessage *message, void *
 { \
     WifiNetworkService *self = (WifiNetworkService*) user_data; \
     LSMessageRef(message); \
-    return self->process##name##Method(lshandle, message); \
+    return self->dispatchRequest(#name, &WifiNetworkService::process##name##Method, lshandle, message); \
 }
 
 LS2_CB_METHOD(GetStatus)
@@ -1178,3 +2461,6 @@ LS2_CB_METHOD(GetProfile)
 LS2_CB_METHOD(GetInfo)
 LS2_CB_METHOD(DeleteProfile)
 LS2_CB_METHOD(GetProfileList)
+LS2_CB_METHOD(GetMetrics)
+LS2_CB_METHOD(DumpTrace)
+LS2_CB_METHOD(GetDiagnostics)
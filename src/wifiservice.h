@@ -30,7 +30,20 @@
 #include "connmanagent.h"
 #include "connectionsettings.h"
 #include "servicerequest.h"
+#include "connectrequestqueue.h"
+#include "connecttimings.h"
+#include "adaptermetrics.h"
+#include "tracering.h"
+#include "statussubscriptions.h"
 #include "serviceprofile.h"
+#include "scanresultcache.h"
+#include "wifiservicelist.h"
+#include "connmanservicetable.h"
+#include "networklistoptions.h"
+#include "signalstrengthpublisher.h"
+#include "jsonwriter.h"
+#include "requestparser.h"
+#include "utilities.h"
 
 class WifiNetworkService : public QObject
 {
@@ -42,8 +55,9 @@ public:
 
     void start(LSPalmService *service);
 
-    void provideInputForConnman(const QVariantMap& fields, const QDBusMessage& message);
-    void processErrorFromConnman(const QString& error);
+    void provideInputForConnman(const QString& servicePath, const QVariantMap& fields,
+                                const QDBusMessage& message);
+    void processErrorFromConnman(const QString& servicePath, const QString& error);
 
     static bool cbGetStatus(LSHandle* lshandle, LSMessage *message, void *user_data);
     static bool cbSetState(LSHandle* lshandle, LSMessage *message, void *user_data);
@@ -53,6 +67,10 @@ public:
     static bool cbGetInfo(LSHandle* lshandle, LSMessage *message, void *user_data);
     static bool cbDeleteProfile(LSHandle* lshandle, LSMessage *message, void *user_data);
     static bool cbGetProfileList(LSHandle* lshandle, LSMessage *message, void *user_data);
+    static bool cbGetMetrics(LSHandle* lshandle, LSMessage *message, void *user_data);
+    static bool cbDumpTrace(LSHandle* lshandle, LSMessage *message, void *user_data);
+    static bool cbGetDiagnostics(LSHandle* lshandle, LSMessage *message, void *user_data);
+    static bool cbSubscriptionCanceled(LSHandle* lshandle, LSMessage *message, void *user_data);
 
     bool processGetStatusMethod(LSHandle *handle, LSMessage *message);
     bool processSetStateMethod(LSHandle *handle, LSMessage *message);
@@ -62,19 +80,28 @@ public:
     bool processDeleteProfileMethod(LSHandle *handle, LSMessage *message);
     bool processGetProfileListMethod(LSHandle *handle, LSMessage *message);
     bool processGetInfoMethod(LSHandle *handle, LSMessage *message);
+    bool processGetMetricsMethod(LSHandle *handle, LSMessage *message);
+    bool processDumpTraceMethod(LSHandle *handle, LSMessage *message);
+    bool processGetDiagnosticsMethod(LSHandle *handle, LSMessage *message);
 
 signals:
     void availabilityChanged(bool available);
 
 private:
+    /* Same values as parse_connman_service_state returns */
     enum ServiceState {
-        IDLE,
-        ASSOCIATION,
-        CONFIGURATION,
-        READY,
-        ONLINE,
-        DISCONNECT,
-        FAILURE,
+        IDLE = CONNMAN_SERVICE_STATE_IDLE,
+        ASSOCIATION = CONNMAN_SERVICE_STATE_ASSOCIATION,
+        CONFIGURATION = CONNMAN_SERVICE_STATE_CONFIGURATION,
+        READY = CONNMAN_SERVICE_STATE_READY,
+        ONLINE = CONNMAN_SERVICE_STATE_ONLINE,
+        DISCONNECT = CONNMAN_SERVICE_STATE_DISCONNECT,
+        FAILURE = CONNMAN_SERVICE_STATE_FAILURE
+    };
+
+    struct ScanRequest {
+        LunaServiceRequestData request;
+        NetworkListOptions options;
     };
 
     bool _wifiServiceActive;
@@ -85,26 +112,125 @@ private:
     int _stateOfCurrentService;
     ConnmanAgent _agent;
     ConnectionSettings _connectionSettings;
-    LunaServiceRequestData _connectServiceRequest;
-    LunaServiceRequestData _scanServiceRequest;
+    ConnectRequestQueue _connectRequests;
+    ConnectTimings _connectTimings;
+    QList<ScanRequest> _scanRequests;
+    bool _scanInProgress;
     ServiceProfileList _profiles;
+    ScanResultCache _scanResults;
+    SignalStrengthPublisher _strengthPublisher;
+    WifiServiceList _wifiServices;
+    ConnmanServiceTable _serviceTable;
     int _scanRetry;
 
-    bool checkForConnmanService(json_object *response);
+    /* findnetworks subscribers get the changes of the network list streamed; these
+     * are the networks (path to name) they know about */
+    unsigned int _networkSubscribers;
+    QHash<QString, QString> _streamedNetworks;
+    guint _networkChangesIdle;
+
+    /* Serialized status payloads; they are only rebuilt once something they report
+     * changed since the version they were built for */
+    unsigned int _statusVersion;
+    unsigned int _statusSnapshotVersion;
+    QByteArray _statusSnapshot;
+    unsigned int _connectionStatusSnapshotVersion;
+    QString _connectionStatusSnapshotState;
+    QByteArray _connectionStatusSnapshot;
+
+    JsonWriter _responseWriter;
+
+    /* getstatus subscriptions; nothing is built for posts nobody wants */
+    StatusSubscriptions _statusSubscriptions;
+
+    /* Status changes held back until the coalescing window ends */
+    unsigned int _coalesceWindow;
+    guint _coalesceTimeout;
+    QString _pendingConnectionState;
+    bool _pendingStrength;
+    unsigned int _pendingStrengthValue;
+    unsigned int _pendingSignalBars;
+
+    AdapterMetrics _metrics;
+    TraceRing _trace;
+
+    /* Requests which came in before we knew connman's state */
+    typedef bool (WifiNetworkService::*MethodHandler)(LSHandle *handle, LSMessage *message);
+
+    struct DeferredRequest {
+        const char *name;
+        MethodHandler handler;
+        LSHandle *handle;
+        LSMessage *message;
+    };
+
+    bool _startupFinished;
+    gint64 _startupBegan;
+    guint _startupTimeout;
+    QList<DeferredRequest> _deferredRequests;
+
+    bool dispatchRequest(const char *name, MethodHandler handler, LSHandle *handle, LSMessage *message);
+    void finishStartup();
+
+    /* On demand mode: status of the last run and tracking of how long we're idle */
+    QByteArray _storedStatus;
+    gint64 _lastActivity;
+    guint _idleCheck;
+
+    void loadStoredStatus();
+    void storeStatus();
+    bool isIdle();
+
+    bool checkForConnmanService(JsonWriter& response);
+    JsonWriter& beginResponse();
     bool setWifiPowered(const bool &powered);
     bool isWifiPowered() const;
-    QList<NetworkService*> listNetworks() const;
-    bool connectWithSsid(const QString& ssid, json_object *request, json_object *response);
-    bool connectWithProfileId(int id, json_object *response);
+    const QList<NetworkService*>& listNetworks() const;
+    bool connectWithSsid(const QString& ssid, const RequestParser& request, QString& errorText);
+    bool connectWithProfileId(int id, QString& errorText);
+    void cancelConnectRequests();
+    void replyToConnectRequests(const QString& servicePath, bool success, const QString& errorText);
 
-    void sendConnectionStatusToSubscribers(const QString& state);
-    void sendConnectionStrengthToSubscribers(const uint strength);
-
-    void appendConnectionStatusToMessage(json_object *message, NetworkService *service, const QString& state);
-    void appendProfileListToMessage(json_object *message);
-    json_object* createMessageFromProfile(ServiceProfile *profile);
+    void markStatusChanged();
+    const QByteArray& statusSnapshot();
+    const QByteArray& connectionStatusSnapshot(const QString& state);
 
+    void postStatusToSubscribers(const QList<QByteArray>& keys, const char *payload, int length);
+    void sendConnectionStatusToSubscribers(const QString& state);
+    void sendConnectionStrengthToSubscribers(const uint strength, const uint signalBars);
+    void postConnectionStrength(const QList<QByteArray>& keys, const uint strength, const uint signalBars);
+    void scheduleCoalescedPost();
+    void flushCoalescedPosts();
+
+    int serviceState(NetworkService *service) const;
+    unsigned int serviceStrength(NetworkService *service) const;
+    const char* palmServiceState(NetworkService *service) const;
+    void appendConnectionStatusToMessage(JsonWriter& message, NetworkService *service, const QString& state);
+    void appendProfileListToMessage(JsonWriter& message);
+    void appendProfileToMessage(JsonWriter& message, ServiceProfile *profile);
+    QByteArray createNetworkEntry(NetworkService *service, const ConnmanServiceInfo& info);
+    QByteArray networkEntry(NetworkService *service, const ConnmanServiceInfo& info);
+    static bool parseNetworkListOptions(const RequestParser& parser, NetworkListOptions& options,
+                                        QString& errorText);
+    void appendFoundNetworksToMessage(JsonWriter& message,
+                                      const NetworkListOptions& options = NetworkListOptions());
+
+    void dropCurrentService();
+    void disconnectCurrentService();
     void assignCurrentService(NetworkService *service);
+    void startScan();
+    void cancelPendingScans();
+    void addNetworksSubscriber(LSHandle *handle, LSMessage *message);
+    void scheduleNetworkChanges();
+    void postNetworkChanges();
+    void postToNetworksSubscribers(const char *payload, int length);
+
+    static gboolean cbTraceSignal(gpointer user_data);
+    static gboolean cbStartupTimeout(gpointer user_data);
+    static gboolean cbIdleCheck(gpointer user_data);
+    static gboolean cbCoalesceTimeout(gpointer user_data);
+    static const char* cbConnectTimeout(const QString& servicePath, void *user_data);
+    static gboolean cbNetworkChanges(gpointer user_data);
 
 private slots:
     void updateTechnologies(const QMap<QString, NetworkTechnology*> &added,
@@ -116,7 +242,11 @@ private slots:
     void wifiScanFinished();
     void currentServiceStateChanged(const QString& changedState);
     void currentServiceStrengthChanged(const uint strength);
+    void publishStrength(unsigned int strength, unsigned int signalBars);
+    void currentServiceIpv4Changed();
     void servicesChanged();
+    void scanResultChanged();
+    void wifiServiceNameChanged();
 
 private:
     Q_DISABLE_COPY(WifiNetworkService);
@@ -0,0 +1,98 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#ifndef WIFISERVICELIST_H_
+#define WIFISERVICELIST_H_
+
+/* View on all wifi services connman knows about. It's only rebuilt when the manager
+ * tells us its list of services changed and keeps indexes by network name and by
+ * D-Bus path next to the list which is in connman's order. */
+class WifiServiceList
+{
+public:
+    WifiServiceList() { }
+    ~WifiServiceList() { }
+
+    /* Replaces the current view with the provided services and reports which paths
+     * appeared or disappeared compared to the previous view */
+    void update(const QList<NetworkService*>& services, QSet<QString> *addedPaths,
+                QSet<QString> *removedPaths)
+    {
+        QHash<QString, NetworkService*> oldServicesByPath = _servicesByPath;
+
+        _services = services;
+        _servicesByPath.clear();
+
+        foreach (NetworkService *service, _services) {
+            QString path = service->dbusPath();
+
+            _servicesByPath.insert(path, service);
+
+            if (oldServicesByPath.remove(path) == 0)
+                addedPaths->insert(path);
+        }
+
+        foreach (const QString& path, oldServicesByPath.keys())
+            removedPaths->insert(path);
+
+        updateNameIndex();
+    }
+
+    /* Multiple services can share the same name (e.g. with different security); in
+     * that case the first one in connman's order wins as it's the preferred one */
+    void updateNameIndex()
+    {
+        _servicesByName.clear();
+
+        foreach (NetworkService *service, _services) {
+            QString name = service->name();
+
+            if (!name.isEmpty() && !_servicesByName.contains(name))
+                _servicesByName.insert(name, service);
+        }
+    }
+
+    const QList<NetworkService*>& services() const
+    {
+        return _services;
+    }
+
+    NetworkService* findByName(const QString& name) const
+    {
+        return _servicesByName.value(name, NULL);
+    }
+
+    NetworkService* findByPath(const QString& path) const
+    {
+        return _servicesByPath.value(path, NULL);
+    }
+
+    bool contains(const QString& path) const
+    {
+        return _servicesByPath.contains(path);
+    }
+
+private:
+    QList<NetworkService*> _services;
+    QHash<QString, NetworkService*> _servicesByPath;
+    QHash<QString, NetworkService*> _servicesByName;
+};
+
+#endif
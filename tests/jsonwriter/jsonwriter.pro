@@ -0,0 +1,22 @@
+TEMPLATE = app
+
+CONFIG += qt
+
+CONFIG += link_pkgconfig
+PKGCONFIG = cjson
+
+QT = core testlib
+
+INCLUDEPATH += ../../src
+
+SOURCES = \
+    tst_jsonwriter.cpp \
+    ../../src/jsonwriter.cpp
+
+HEADERS = \
+    ../../src/jsonwriter.h
+
+TARGET = tst_jsonwriter
+
+OBJECTS_DIR = .obj
+MOC_DIR = .moc
@@ -0,0 +1,363 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#include <string.h>
+
+#include <QtTest/QtTest>
+#include <cjson/json.h>
+
+#include "jsonwriter.h"
+
+/* SSIDs are up to 32 arbitrary bytes; these cover what the escaping has to deal
+ * with */
+static const char *test_ssids[] = {
+    "HomeNetwork",
+    "Quote\"d \\ back\\slash",
+    "Caf\xc3\xa9 \xe6\x97\xa5\xe6\x9c\xac",
+    "Tab\tNew\nline\r",
+    "\x01\x02\x1f control",
+    "Signal \xf0\x9f\x93\xb6",
+    ""
+};
+
+#define TEST_SSID_COUNT     (sizeof(test_ssids) / sizeof(test_ssids[0]))
+
+/* Every heap allocation of the process goes through these, the ones of Qt and
+ * cjson included, so the allocation benchmarks can count them */
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+static unsigned long allocation_count = 0;
+
+extern "C" void *malloc(size_t size)
+{
+    allocation_count++;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t n, size_t size)
+{
+    allocation_count++;
+    return __libc_calloc(n, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    allocation_count++;
+    return __libc_realloc(ptr, size);
+}
+
+class TestJsonWriter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void escaping_data();
+    void escaping();
+    void escapingOfKeys();
+    void separators();
+    void resetKeepsCapacity();
+    void roundTripThroughCJson();
+
+    void benchmarkJsonWriter_data();
+    void benchmarkJsonWriter();
+    void benchmarkCJson_data();
+    void benchmarkCJson();
+    void allocationsJsonWriter_data();
+    void allocationsJsonWriter();
+    void allocationsCJson_data();
+    void allocationsCJson();
+};
+
+void TestJsonWriter::escaping_data()
+{
+    QTest::addColumn<QByteArray>("input");
+    QTest::addColumn<QByteArray>("expected");
+
+    QTest::newRow("plain") << QByteArray("HomeNetwork") << QByteArray("\"HomeNetwork\"");
+    QTest::newRow("empty") << QByteArray("") << QByteArray("\"\"");
+    QTest::newRow("quotes") << QByteArray("say \"hi\"") << QByteArray("\"say \\\"hi\\\"\"");
+    QTest::newRow("backslash") << QByteArray("a\\b") << QByteArray("\"a\\\\b\"");
+    QTest::newRow("slash") << QByteArray("a/b") << QByteArray("\"a/b\"");
+    QTest::newRow("named controls") << QByteArray("\b\f\n\r\t")
+                                    << QByteArray("\"\\b\\f\\n\\r\\t\"");
+    QTest::newRow("other controls") << QByteArray("\x01x\x1f")
+                                    << QByteArray("\"\\u0001x\\u001f\"");
+    QTest::newRow("delete") << QByteArray("\x7f") << QByteArray("\"\x7f\"");
+    QTest::newRow("latin1") << QByteArray("Caf\xc3\xa9") << QByteArray("\"Caf\xc3\xa9\"");
+    QTest::newRow("cjk") << QByteArray("\xe6\x97\xa5\xe6\x9c\xac")
+                         << QByteArray("\"\xe6\x97\xa5\xe6\x9c\xac\"");
+    QTest::newRow("outside bmp") << QByteArray("\xf0\x9f\x93\xb6")
+                                 << QByteArray("\"\xf0\x9f\x93\xb6\"");
+    QTest::newRow("mixed") << QByteArray("\"\xc3\xa9\"\n")
+                           << QByteArray("\"\\\"\xc3\xa9\\\"\\n\"");
+}
+
+/* Strings go in as UTF-8 or as QString and have to come out the same either way */
+void TestJsonWriter::escaping()
+{
+    QFETCH(QByteArray, input);
+    QFETCH(QByteArray, expected);
+    JsonWriter writer;
+
+    writer.value(input.constData());
+    QCOMPARE(writer.toByteArray(), expected);
+
+    writer.reset();
+    writer.value(QString::fromUtf8(input.constData(), input.length()));
+    QCOMPARE(writer.toByteArray(), expected);
+}
+
+void TestJsonWriter::escapingOfKeys()
+{
+    JsonWriter writer;
+
+    writer.beginObject();
+    writer.member("a\"b\n", 1);
+    writer.endObject();
+
+    QCOMPARE(writer.toByteArray(), QByteArray("{\"a\\\"b\\n\":1}"));
+}
+
+void TestJsonWriter::separators()
+{
+    JsonWriter writer;
+
+    writer.beginObject();
+    writer.member("returnValue", true);
+    writer.key("networks").beginArray();
+    writer.beginObject().member("ssid", "a").member("signalBars", 3).endObject();
+    writer.beginObject().member("ssid", "b").member("signalLevel", 70u).endObject();
+    writer.endArray();
+    writer.key("empty").beginArray().endArray();
+    writer.key("raw").raw("{\"x\":null}");
+    writer.member("text", (const char*) NULL);
+    writer.endObject();
+
+    QCOMPARE(writer.toByteArray(),
+             QByteArray("{\"returnValue\":true,\"networks\":[{\"ssid\":\"a\",\"signalBars\":3},"
+                        "{\"ssid\":\"b\",\"signalLevel\":70}],\"empty\":[],\"raw\":{\"x\":null},"
+                        "\"text\":null}"));
+}
+
+void TestJsonWriter::resetKeepsCapacity()
+{
+    JsonWriter writer(64);
+    const char *data;
+    int n;
+
+    /* Stays within the initial capacity */
+    for (n = 0; n < 4; n++)
+        writer.value("0123456789");
+    data = writer.data();
+
+    writer.reset();
+    QCOMPARE(writer.length(), 0);
+
+    writer.beginObject().member("returnValue", false).endObject();
+    QCOMPARE(writer.toByteArray(), QByteArray("{\"returnValue\":false}"));
+    QVERIFY(writer.data() == data);
+}
+
+/* Whatever we write has to be read back unchanged by the JSON parser our callers
+ * use */
+void TestJsonWriter::roundTripThroughCJson()
+{
+    QList<QByteArray> inputs;
+    json_object *parsed;
+    json_object *ssid;
+    JsonWriter writer;
+    char c;
+
+    for (c = 1; c <= 0x7e; c++)
+        inputs.append(QByteArray("<") + c + ">");
+
+    for (unsigned int n = 0; n < TEST_SSID_COUNT; n++)
+        inputs.append(QByteArray(test_ssids[n]));
+
+    foreach (const QByteArray& input, inputs) {
+        writer.reset();
+        writer.beginObject().member("ssid", input.constData()).endObject();
+
+        parsed = json_tokener_parse(writer.data());
+        QVERIFY2(parsed != NULL && !is_error(parsed), writer.data());
+
+        ssid = json_object_object_get(parsed, "ssid");
+        QVERIFY(ssid != NULL);
+        QCOMPARE(QByteArray(json_object_get_string(ssid)), input);
+
+        json_object_put(parsed);
+    }
+}
+
+/* A findnetworks reply with the given number of networks, written the way the
+ * adapter does it: into one writer whose buffer is reused for every message */
+static int write_reply(JsonWriter& writer, int count)
+{
+    int n;
+
+    writer.reset();
+    writer.beginObject();
+    writer.member("returnValue", true);
+    writer.key("foundNetworks").beginArray();
+
+    for (n = 0; n < count; n++) {
+        writer.beginObject();
+        writer.key("networkInfo").beginObject();
+        writer.member("ssid", test_ssids[n % TEST_SSID_COUNT]);
+        writer.member("securityType", "psk");
+        writer.member("signalBars", n % 4);
+        writer.member("signalLevel", (unsigned int) (n % 100));
+        writer.member("connectState", "notAssociated");
+        writer.endObject();
+        writer.endObject();
+    }
+
+    writer.endArray();
+    writer.endObject();
+
+    return writer.length();
+}
+
+/* The same reply built as cjson object tree and serialized as the adapter did
+ * before it had its own writer */
+static int build_reply(int count)
+{
+    json_object *response;
+    json_object *networks;
+    json_object *network;
+    json_object *networkInfo;
+    int length;
+    int n;
+
+    response = json_object_new_object();
+    json_object_object_add(response, "returnValue", json_object_new_boolean(true));
+
+    networks = json_object_new_array();
+
+    for (n = 0; n < count; n++) {
+        networkInfo = json_object_new_object();
+        json_object_object_add(networkInfo, "ssid",
+            json_object_new_string(test_ssids[n % TEST_SSID_COUNT]));
+        json_object_object_add(networkInfo, "securityType", json_object_new_string("psk"));
+        json_object_object_add(networkInfo, "signalBars", json_object_new_int(n % 4));
+        json_object_object_add(networkInfo, "signalLevel", json_object_new_int(n % 100));
+        json_object_object_add(networkInfo, "connectState",
+            json_object_new_string("notAssociated"));
+
+        network = json_object_new_object();
+        json_object_object_add(network, "networkInfo", networkInfo);
+        json_object_array_add(networks, network);
+    }
+
+    json_object_object_add(response, "foundNetworks", networks);
+
+    length = strlen(json_object_to_json_string(response));
+    json_object_put(response);
+
+    return length;
+}
+
+void TestJsonWriter::benchmarkJsonWriter_data()
+{
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("10") << 10;
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+}
+
+void TestJsonWriter::benchmarkJsonWriter()
+{
+    QFETCH(int, count);
+    JsonWriter writer;
+    int length = 0;
+
+    QBENCHMARK {
+        length = write_reply(writer, count);
+    }
+
+    QVERIFY(length > 0);
+}
+
+void TestJsonWriter::benchmarkCJson_data()
+{
+    benchmarkJsonWriter_data();
+}
+
+void TestJsonWriter::benchmarkCJson()
+{
+    QFETCH(int, count);
+    int length = 0;
+
+    QBENCHMARK {
+        length = build_reply(count);
+    }
+
+    QVERIFY(length > 0);
+}
+
+void TestJsonWriter::allocationsJsonWriter_data()
+{
+    benchmarkJsonWriter_data();
+}
+
+/* Reported as events per reply. The first reply grows the buffer; what counts is
+ * every reply after it. */
+void TestJsonWriter::allocationsJsonWriter()
+{
+    QFETCH(int, count);
+    JsonWriter writer;
+    unsigned long allocations;
+
+    write_reply(writer, count);
+
+    allocations = allocation_count;
+    write_reply(writer, count);
+    allocations = allocation_count - allocations;
+
+    QCOMPARE(allocations, 0UL);
+    QTest::setBenchmarkResult(allocations, QTest::Events);
+}
+
+void TestJsonWriter::allocationsCJson_data()
+{
+    benchmarkJsonWriter_data();
+}
+
+void TestJsonWriter::allocationsCJson()
+{
+    QFETCH(int, count);
+    unsigned long allocations;
+
+    build_reply(count);
+
+    allocations = allocation_count;
+    build_reply(count);
+    allocations = allocation_count - allocations;
+
+    QVERIFY(allocations > 0);
+    QTest::setBenchmarkResult(allocations, QTest::Events);
+}
+
+QTEST_APPLESS_MAIN(TestJsonWriter)
+
+#include "tst_jsonwriter.moc"
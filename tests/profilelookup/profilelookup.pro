@@ -0,0 +1,23 @@
+TEMPLATE = app
+
+CONFIG += qt
+
+CONFIG += link_pkgconfig
+PKGCONFIG = glib-2.0
+
+QT = core testlib
+
+INCLUDEPATH += ../../src
+
+SOURCES = \
+    tst_profilelookup.cpp \
+    ../../src/profilestore.cpp
+
+HEADERS = \
+    ../../src/serviceprofile.h \
+    ../../src/profilestore.h
+
+TARGET = tst_profilelookup
+
+OBJECTS_DIR = .obj
+MOC_DIR = .moc
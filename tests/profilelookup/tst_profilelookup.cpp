@@ -0,0 +1,353 @@
+/*
+ * @@@LICENSE
+ *
+ * Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * LICENSE@@@
+ */
+
+#include <QtTest/QtTest>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+/* Stands in for the connman-qt service object; profiles only ask it for its path,
+ * name and security */
+class NetworkService
+{
+public:
+    NetworkService(const QString& path, const QString& name, const QString& security) :
+        _path(path),
+        _name(name)
+    {
+        _security.append(security);
+    }
+
+    const QString dbusPath() const { return _path; }
+    const QString name() const { return _name; }
+    const QStringList security() const { return _security; }
+
+private:
+    QString _path;
+    QString _name;
+    QStringList _security;
+};
+
+#include "serviceprofile.h"
+
+/* Lookups per benchmark iteration, independent of the number of profiles */
+#define BENCHMARK_LOOKUPS   1000
+
+static QString service_path(int n)
+{
+    return QString(CONNMAN_SERVICE_PATH_PREFIX) +
+           QString("wifi_001122334455_%1_managed_psk").arg(n, 8, 16, QChar('0'));
+}
+
+class TestProfileLookup : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void lookupById();
+    void lookupByPath();
+    void removeAndReAdd();
+    void reloadKeepsIds();
+    void reloadSkipsInvalidRecords();
+    void pruneDetached();
+
+    void benchmarkLookup_data();
+    void benchmarkLookup();
+    void benchmarkLinearScan_data();
+    void benchmarkLinearScan();
+
+private:
+    QList<NetworkService*> _services;
+    gchar *_directory;
+
+    void createServices(int count);
+    QString storePath() const;
+};
+
+void TestProfileLookup::init()
+{
+    _directory = g_dir_make_tmp("profilelookup-XXXXXX", NULL);
+    QVERIFY(_directory != NULL);
+}
+
+void TestProfileLookup::cleanup()
+{
+    qDeleteAll(_services);
+    _services.clear();
+
+    g_unlink(storePath().toUtf8().constData());
+    g_rmdir(_directory);
+    g_free(_directory);
+}
+
+void TestProfileLookup::createServices(int count)
+{
+    int n;
+
+    for (n = 0; n < count; n++)
+        _services.append(new NetworkService(service_path(n), QString("network %1").arg(n), "psk"));
+}
+
+QString TestProfileLookup::storePath() const
+{
+    return QString(_directory) + "/profiles";
+}
+
+void TestProfileLookup::lookupById()
+{
+    ServiceProfileList profiles;
+    ServiceProfile *first, *second;
+
+    createServices(2);
+
+    first = profiles.createProfile(_services[0]);
+    second = profiles.createProfile(_services[1]);
+
+    QVERIFY(first->id() != second->id());
+    QCOMPARE(profiles.findProfileById(first->id()), first);
+    QCOMPARE(profiles.findProfileById(second->id()), second);
+    QVERIFY(profiles.findProfileById(second->id() + 1) == NULL);
+}
+
+void TestProfileLookup::lookupByPath()
+{
+    ServiceProfileList profiles;
+    ServiceProfile *first, *second;
+
+    createServices(3);
+
+    first = profiles.createProfile(_services[0]);
+    second = profiles.createProfile(_services[1]);
+
+    QCOMPARE(profiles.findProfileByDBusPath(service_path(0)), first);
+    QCOMPARE(profiles.findProfileByDBusPath(service_path(1)), second);
+    QVERIFY(profiles.findProfileByDBusPath(service_path(2)) == NULL);
+    QCOMPARE(second->name(), QString("network 1"));
+    QCOMPARE(second->security(), QString("psk"));
+}
+
+void TestProfileLookup::removeAndReAdd()
+{
+    ServiceProfileList profiles;
+    ServiceProfile *profile, *other;
+    int oldId;
+
+    createServices(2);
+
+    profile = profiles.createProfile(_services[0]);
+    other = profiles.createProfile(_services[1]);
+    oldId = profile->id();
+
+    profiles.removeProfileById(oldId);
+
+    QVERIFY(profiles.findProfileById(oldId) == NULL);
+    QVERIFY(profiles.findProfileByDBusPath(service_path(0)) == NULL);
+    QCOMPARE(profiles.list().size(), 1);
+
+    /* The other profile isn't affected by the removal */
+    QCOMPARE(profiles.findProfileById(other->id()), other);
+    QCOMPARE(profiles.findProfileByDBusPath(service_path(1)), other);
+
+    /* A profile created again for the same service gets a new id */
+    profile = profiles.createProfile(_services[0]);
+
+    QVERIFY(profile->id() != oldId);
+    QVERIFY(profiles.findProfileById(oldId) == NULL);
+    QCOMPARE(profiles.findProfileById(profile->id()), profile);
+    QCOMPARE(profiles.findProfileByDBusPath(service_path(0)), profile);
+    QCOMPARE(profiles.list().size(), 2);
+    QCOMPARE(profiles.list().last(), profile);
+}
+
+void TestProfileLookup::reloadKeepsIds()
+{
+    QList<int> ids;
+    int removedId;
+    int n;
+
+    createServices(3);
+
+    {
+        ServiceProfileList profiles;
+
+        profiles.load(storePath());
+
+        for (n = 0; n < 3; n++)
+            ids.append(profiles.createProfile(_services[n])->id());
+
+        removedId = ids.takeAt(1);
+        profiles.removeProfileById(removedId);
+    }
+
+    ServiceProfileList profiles;
+    ServiceProfile *profile;
+
+    profiles.load(storePath());
+
+    QCOMPARE(profiles.list().size(), 2);
+    QVERIFY(profiles.findProfileById(removedId) == NULL);
+    QVERIFY(profiles.findProfileByDBusPath(service_path(1)) == NULL);
+
+    QCOMPARE(profiles.findProfileByDBusPath(service_path(0))->id(), ids[0]);
+    QCOMPARE(profiles.findProfileByDBusPath(service_path(2))->id(), ids[1]);
+    QCOMPARE(profiles.findProfileById(ids[1])->name(), QString("network 2"));
+
+    /* Ids of removed profiles aren't handed out again */
+    profile = profiles.createProfile(_services[1]);
+    QVERIFY(profile->id() > ids[1]);
+    QCOMPARE(profiles.findProfileByDBusPath(service_path(1)), profile);
+}
+
+void TestProfileLookup::reloadSkipsInvalidRecords()
+{
+    const char *contents = "1\t9\n"
+                           "3\twifi_a\tpsk\t6e6574776f726b2030\n"
+                           "x\twifi_b\tpsk\t\n"
+                           "4\t\tnone\t\n"
+                           "5\twifi_c\tnone\t6e6574776f726b2031\n"
+                           "6\twifi_d";
+    ServiceProfileList profiles;
+
+    QVERIFY(g_file_set_contents(storePath().toUtf8().constData(), contents, -1, NULL));
+
+    profiles.load(storePath());
+
+    QCOMPARE(profiles.list().size(), 2);
+    QCOMPARE(profiles.findProfileById(3)->name(), QString("network 0"));
+    QCOMPARE(profiles.findProfileById(5)->name(), QString("network 1"));
+    QVERIFY(profiles.findProfileById(4) == NULL);
+    QVERIFY(profiles.findProfileById(6) == NULL);
+}
+
+void TestProfileLookup::pruneDetached()
+{
+    ServiceProfileList profiles;
+    ServiceProfile *profile;
+    int firstId, secondId;
+    int n;
+
+    createServices(PROFILE_LIST_MAX_SIZE + 2);
+
+    for (n = 0; n < PROFILE_LIST_MAX_SIZE; n++)
+        profiles.createProfile(_services[n]);
+
+    firstId = profiles.list().first()->id();
+    secondId = profiles.list().at(1)->id();
+
+    /* Nothing is dropped while all networks are in range */
+    profiles.createProfile(_services[n++]);
+    QCOMPARE(profiles.list().size(), PROFILE_LIST_MAX_SIZE + 1);
+
+    /* The oldest profile out of range goes first */
+    profiles.detachService(service_path(1));
+    profiles.detachService(service_path(2));
+    profile = profiles.createProfile(_services[n]);
+
+    QCOMPARE(profiles.list().size(), PROFILE_LIST_MAX_SIZE + 1);
+    QVERIFY(profiles.findProfileById(firstId) != NULL);
+    QVERIFY(profiles.findProfileById(secondId) == NULL);
+    QVERIFY(profiles.findProfileByDBusPath(service_path(1)) == NULL);
+    QVERIFY(profiles.findProfileByDBusPath(service_path(2)) != NULL);
+    QCOMPARE(profiles.list().last(), profile);
+}
+
+void TestProfileLookup::benchmarkLookup_data()
+{
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("10") << 10;
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+    QTest::newRow("5000") << 5000;
+}
+
+/* Every iteration does the same number of lookups by path and by id, spread over
+ * all known networks, so the result is the cost of a lookup and stays flat as long
+ * as that doesn't depend on the number of profiles */
+void TestProfileLookup::benchmarkLookup()
+{
+    QFETCH(int, count);
+    ServiceProfileList profiles;
+    QList<int> ids;
+    int found = 0;
+    int n;
+
+    createServices(count);
+
+    foreach (NetworkService *service, _services)
+        ids.append(profiles.createProfile(service)->id());
+
+    QBENCHMARK {
+        for (n = 0; n < BENCHMARK_LOOKUPS; n++) {
+            if (profiles.findProfileByDBusPath(_services[n % count]->dbusPath()) != NULL)
+                found++;
+            if (profiles.findProfileById(ids[n % count]) != NULL)
+                found++;
+        }
+    }
+
+    QVERIFY(found > 0);
+}
+
+void TestProfileLookup::benchmarkLinearScan_data()
+{
+    benchmarkLookup_data();
+}
+
+/* The same lookups as a scan through the list of profiles for comparison */
+void TestProfileLookup::benchmarkLinearScan()
+{
+    QFETCH(int, count);
+    ServiceProfileList profiles;
+    QList<int> ids;
+    int found = 0;
+    int n;
+
+    createServices(count);
+
+    foreach (NetworkService *service, _services)
+        ids.append(profiles.createProfile(service)->id());
+
+    QBENCHMARK {
+        for (n = 0; n < BENCHMARK_LOOKUPS; n++) {
+            foreach (ServiceProfile *profile, profiles.list()) {
+                if (profile->dbusPath() == _services[n % count]->dbusPath()) {
+                    found++;
+                    break;
+                }
+            }
+
+            foreach (ServiceProfile *profile, profiles.list()) {
+                if (profile->id() == ids[n % count]) {
+                    found++;
+                    break;
+                }
+            }
+        }
+    }
+
+    QVERIFY(found > 0);
+}
+
+QTEST_APPLESS_MAIN(TestProfileLookup)
+
+#include "tst_profilelookup.moc"